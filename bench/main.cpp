@@ -0,0 +1,267 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include "../src/Benchmark.hpp"
+#include "../src/StrUtils.hpp"
+#include "../src/NumUtils.hpp"
+#include "../src/FSUtils.hpp"
+#include "../src/CsvMat.hpp"
+#include "../src/FileHandle.hpp"
+#include "../src/FileCache.hpp"
+#include "../src/AsyncIO.hpp"
+#include "../src/Mat.hpp"
+#include "../src/TSQueue.hpp"
+#include "../src/SPSCQueue.hpp"
+#include "../src/ThreadPool.hpp"
+#include "../src/TimeStamp.hpp"
+#include "../src/Utils.hpp"
+#include "../src/TSLogger.hpp"
+#include "../src/Histogram.hpp"
+
+// ./out            table on stdout
+// ./out --csv      CSV on stdout
+// ./out --json     JSON on stdout
+// ./out --quick    fewer / shorter samples, for smoke testing the build
+// ./out --perf     add hardware counters (cycles, IPC, cache / branch misses) per operation
+
+namespace{
+    const std::string BENCH_FILE{"bench.txt"};
+    const std::string NUMERIC_FILE{"bench.csv"};
+    const std::string BENCH_DIR{"bench_dir"};
+
+    void strUtils(Benchmark &b){
+        std::string padded{"   \t some text that needs cleaning up \n  "};
+        std::string csv_line{"1.5,2.25,hello,world,3,4,5,6,7,8"};
+        b.run("StrUtils::trim", [&]{ Benchmark::doNotOptimize(StrUtils::trim(padded)); });
+        b.run("StrUtils::toUpper", [&]{ Benchmark::doNotOptimize(StrUtils::toUpper(csv_line)); });
+        b.run("StrUtils::parseOnCharDelim", [&]{
+            Benchmark::doNotOptimize(StrUtils::parseOnCharDelim(csv_line, ','));
+        });
+    }
+
+    void numUtils(Benchmark &b){
+        std::string dbl{"3.14159265"};
+        std::vector<double> vals;
+        for(int i = 0; i < 1001; ++i)
+            vals.push_back(NumUtils::randomDouble(0, 1000));
+        b.run("NumUtils::strToDouble", [&]{ Benchmark::doNotOptimize(NumUtils::strToDouble(dbl)); });
+        b.run("NumUtils::getMedian (1001)", [&]{ Benchmark::doNotOptimize(NumUtils::getMedian(vals)); });
+    }
+
+    void mat(Benchmark &b){
+        Mat small(2, 16, 16);
+        Mat medium(2, 32, 32);
+        b.run("Mat 16x16 * 16x16", [&]{ Benchmark::doNotOptimize(small * small); });
+        b.run("Mat 32x32 * 32x32", [&]{ Benchmark::doNotOptimize(medium * medium); });
+        b.run("Mat 32x32 + 32x32", [&]{ Benchmark::doNotOptimize(medium + medium); });
+    }
+
+    void queues(Benchmark &b){
+        TSQueue<int> tsq;
+        SPSCQueue<int> spsc(1024);
+        int val = 0;
+        b.run("TSQueue push + pop", [&]{
+            tsq.push(1);
+            tsq.try_and_pop(val);
+            Benchmark::doNotOptimize(val);
+        });
+        b.run("SPSCQueue push + pop", [&]{
+            spsc.try_push(1);
+            spsc.try_pop(val);
+            Benchmark::doNotOptimize(val);
+        });
+
+        ThreadPool pool(2);
+        b.run("ThreadPool push + get", [&]{ Benchmark::doNotOptimize(pool.push([]{ return 1; }).get()); });
+    }
+
+    void timeStamps(Benchmark &b){
+        TimeStamp stamp;
+        char buf[TimeStamp::MAX_LEN];
+        b.run("TimeStamp::writeNow", [&]{
+            Benchmark::doNotOptimize(stamp.writeNow(buf));
+            Benchmark::clobberMemory();
+        });
+        b.run("Utils::timeStamp", []{ Benchmark::doNotOptimize(Utils::timeStamp()); });
+
+        Timer t;
+        b.run("Timer start + stop", [&]{
+            t.startTimer();
+            t.stopTimer();
+            Benchmark::doNotOptimize(t);
+        });
+        TSCTimer tsc;
+        b.run("TSCTimer start + stop", [&]{
+            tsc.startTimer();
+            tsc.stopTimer();
+            Benchmark::doNotOptimize(tsc);
+        });
+
+        Histogram h;
+        uint64_t v = 0;
+        b.run("Histogram::record", [&]{ h.record(++v & 0xFFFFF); });
+    }
+
+    void logger(Benchmark &b){
+        TSLogger l("bench.log");
+        l.deletePreviousMessagesInLogFile();
+        b.run("TSLogger::info", [&]{ l.info("benchmark message", FUNC); });
+    }
+
+    void fsUtils(Benchmark &b){
+        {
+            std::ofstream out(BENCH_FILE);
+            for(int i = 0; i < 10000; ++i)
+                out << "line " << i << ",1.5,2.5,3.5\n";
+            std::ofstream numeric(NUMERIC_FILE);
+            for(int i = 0; i < 10000; ++i)
+                numeric << "1.5,2.5,3.5\n";
+        }
+        b.run("FSUtils::readFullFile (10k lines)", []{
+            Benchmark::doNotOptimize(FSUtils::readFullFile(BENCH_FILE));
+        });
+        b.run("MappedFile open (10k lines)", []{
+            MappedFile f(BENCH_FILE);
+            Benchmark::doNotOptimize(f.data());
+        });
+        b.run("FSUtils::readLineByLine (10k lines)", []{
+            Benchmark::doNotOptimize(FSUtils::readLineByLine(BENCH_FILE));
+        });
+        b.run("FSUtils::lines (10k lines)", []{
+            size_t bytes = 0;
+            for(std::string_view line : FSUtils::lines(BENCH_FILE))
+                bytes += line.size();
+            Benchmark::doNotOptimize(bytes);
+        });
+        b.run("FSUtils::lineCount (10k lines)", []{
+            Benchmark::doNotOptimize(FSUtils::lineCount(BENCH_FILE));
+        });
+        b.run("FSUtils::csvToMatrix (10k lines)", []{
+            Benchmark::doNotOptimize(FSUtils::csvToMatrix(BENCH_FILE));
+        });
+        b.run("CSVReader sum column (10k lines)", []{
+            CSVReader csv(BENCH_FILE);
+            double sum = 0;
+            while(csv.next())
+                sum += csv.row().get<double>(1);
+            Benchmark::doNotOptimize(sum);
+        });
+        b.run("Mat(csvToMatrix) (10k x 3)", []{
+            auto rows = FSUtils::csvToMatrix(BENCH_FILE);
+            for(auto &&r : rows)
+                r.erase(r.begin());
+            Benchmark::doNotOptimize(Mat(rows));
+        });
+        b.run("FSUtils::loadNumericCsv (10k x 3)", []{
+            Benchmark::doNotOptimize(FSUtils::loadNumericCsv(NUMERIC_FILE));
+        });
+        b.run("FSUtils::fexists", []{ Benchmark::doNotOptimize(FSUtils::fexists(BENCH_FILE)); });
+        b.run("FSUtils::getModifiedTime", []{
+            Benchmark::doNotOptimize(FSUtils::getModifiedTime(BENCH_FILE));
+        });
+        b.run("FSUtils::fileInfo", []{
+            Benchmark::doNotOptimize(FSUtils::fileInfo(BENCH_FILE).mtimeNs());
+        });
+        {
+            FileHandle stat_fh(BENCH_FILE);
+            FileHandle notify_fh(BENCH_FILE, false, FileHandle::Freshness::NOTIFY);
+            stat_fh.readAsString();
+            notify_fh.readAsString();
+            b.run("FileHandle cached read (STAT)", [&stat_fh]{
+                Benchmark::doNotOptimize(stat_fh.readAsString().size());
+            });
+            b.run("FileHandle cached read (NOTIFY)", [&notify_fh]{
+                Benchmark::doNotOptimize(notify_fh.readAsString().size());
+            });
+            b.run("FileHandle::text (NOTIFY)", [&notify_fh]{
+                Benchmark::doNotOptimize(notify_fh.text().size());
+            });
+            b.run("FileHandle::lines (NOTIFY)", [&notify_fh]{
+                Benchmark::doNotOptimize(notify_fh.lines().size());
+            });
+            b.run("FileCache::get (STAT)", []{
+                Benchmark::doNotOptimize(FileCache::instance().get(BENCH_FILE)->text().size());
+            });
+            FileCache::instance().clear();
+        }
+        b.run("FSUtils::copyf (10k lines)", []{
+            Benchmark::doNotOptimize(FSUtils::copyf(BENCH_FILE, BENCH_FILE + ".copy"));
+            FSUtils::deleteFile(BENCH_FILE + ".copy");
+        });
+        FSUtils::deleteFile(BENCH_FILE);
+        FSUtils::deleteFile(NUMERIC_FILE);
+
+        // 10 directories of 100 files
+        FSUtils::makeDir(BENCH_DIR);
+        for(int d = 0; d < 10; ++d){
+            std::string dir = BENCH_DIR + "/d" + std::to_string(d);
+            FSUtils::makeDir(dir);
+            for(int f = 0; f < 100; ++f)
+                std::ofstream(dir + "/f" + std::to_string(f) + ".txt") << "bench file " << f << "\n";
+        }
+        b.run("DirWalker (1000 files)", []{
+            size_t n = 0;
+            for(auto &e : DirWalker(BENCH_DIR))
+                n += e.isFile();
+            Benchmark::doNotOptimize(n);
+        });
+        ThreadPool pool(4);
+        b.run("FSUtils::scanDir (1000 files)", [&]{
+            Benchmark::doNotOptimize(FSUtils::scanDir(BENCH_DIR, pool).files_);
+        });
+        b.run("FSUtils::getFilesInDir (100 files)", []{
+            Benchmark::doNotOptimize(FSUtils::getFilesInDir(BENCH_DIR + "/d0"));
+        });
+        std::vector<std::string> small_files;
+        for(int f = 0; f < 100; ++f)
+            small_files.push_back(BENCH_DIR + "/d0/f" + std::to_string(f) + ".txt");
+        b.run("FSUtils::readFullFile (100 small files)", [&]{
+            for(auto &f : small_files)
+                Benchmark::doNotOptimize(FSUtils::readFullFile(f));
+        });
+        AsyncIO io;
+        b.run(io.usingUring() ? "AsyncIO::readFiles (100 small files, io_uring)"
+                              : "AsyncIO::readFiles (100 small files, thread pool)", [&]{
+            Benchmark::doNotOptimize(io.readFiles(small_files));
+        });
+        FSUtils::deleteDir(BENCH_DIR);
+    }
+}
+
+int main(int argc, char **argv){
+    bool csv = false, json = false, quick = false, perf = false;
+    for(int i = 1; i < argc; ++i){
+        if(std::strcmp(argv[i], "--csv") == 0) csv = true;
+        else if(std::strcmp(argv[i], "--json") == 0) json = true;
+        else if(std::strcmp(argv[i], "--quick") == 0) quick = true;
+        else if(std::strcmp(argv[i], "--perf") == 0) perf = true;
+    }
+
+    Benchmark b;
+    if(quick)
+        b.warmup(std::chrono::milliseconds(1)).samples(3).minSampleTime(std::chrono::milliseconds(1));
+    if(perf){
+        PerfCounters pc;
+        if(!pc.error().empty())
+            std::cerr << "Some hardware counters are unavailable: " << pc.error() << '\n';
+        b.hardwareCounters(true);
+    }
+
+    strUtils(b);
+    numUtils(b);
+    mat(b);
+    queues(b);
+    timeStamps(b);
+    logger(b);
+    fsUtils(b);
+
+    if(csv)
+        b.writeCSV(std::cout);
+    else if(json)
+        b.writeJSON(std::cout);
+    else
+        b.printTable(std::cout);
+
+    return 0;
+}
@@ -24,6 +24,12 @@ int main(){
     std::cout << license_str << std::endl;
     std::cout << std::endl;
 
+    //----- MappedFile
+    MappedFile mapped(LICENSE, MappedFile::SEQUENTIAL | MappedFile::WILLNEED);
+    std::cout << "MappedFile(LICENSE) size: " << mapped.size() << ", first line: "
+        << mapped.view().substr(0, mapped.view().find('\n')) << "\n";
+    std::cout << std::endl;
+
     //----- readLineByLine
     std::cout << "readLineByLine(LICENSE): \n";
     auto license_vec = FSUtils::readLineByLine(LICENSE);
@@ -31,6 +37,15 @@ int main(){
         std::cout << str << "\n";
     std::cout << std::endl;
 
+    //----- lines
+    std::cout << "Longest line in LICENSE: ";
+    std::string_view longest;
+    for(std::string_view line : FSUtils::lines(LICENSE))
+        if(line.size() > longest.size())
+            longest = line;
+    std::cout << longest.size() << " characters\n";
+    std::cout << std::endl;
+
     //----- lineCount
     auto license_lc = FSUtils::lineCount(LICENSE);
     std::cout << "# of lines in LICENSE: " << license_lc << "\n";
@@ -0,0 +1,36 @@
+#include <iostream>
+#include "../../src/TSLogger.hpp"
+#include "../../src/LogRing.hpp"
+
+// ./out              log some messages, kill the logger, then decode the ring
+// ./out <ring file>  decode a ring file left behind by a crashed process
+int main(int argc, char **argv){
+    if(argc > 1){
+        try{
+            LogRing::dump(argv[1], std::cout);
+        }
+        catch(const std::runtime_error &e){
+            std::cerr << e.what() << '\n';
+            return 1;
+        }
+        return 0;
+    }
+
+    {
+        TSLogger l("example.log");
+        l.deletePreviousMessagesInLogFile();
+        l.enableFlightRecorder("example.ring", 64);
+
+        for(int i = 0; i < 100; ++i)
+            l.info("Message " + std::to_string(i), FUNC);
+        l.error("About to die", LogFields().add("code", 42), FUNC);
+
+        // Whatever the background thread hasn't written yet is lost from example.log...
+        l.kill();
+    }
+
+    // ...but the last 64 messages are still in the ring
+    size_t records = LogRing::dump("example.ring", std::cout);
+    std::cout << "Decoded " << records << " records\n";
+    return 0;
+}
@@ -0,0 +1,48 @@
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <vector>
+#include <cmath>
+#include "../../src/Profiler.hpp"
+
+// Built with -DENABLE_PROFILER (see makefile), without it every PROFILE_ macro compiles away
+
+double slowSqrt(double x){
+    PROFILE_FUNCTION();
+    double r = x;
+    for(int i = 0; i < 20; ++i)
+        r = 0.5 * (r + x / r);
+    return r;
+}
+
+double work(int n){
+    PROFILE_ZONE("work");
+    double sum = 0;
+    for(int i = 1; i < n; ++i)
+        sum += slowSqrt(i);
+    {
+        PROFILE_ZONE("work::tail");
+        for(int i = 1; i < n; ++i)
+            sum += std::sqrt(i);
+    }
+    return sum;
+}
+
+int main(){
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; ++t)
+        threads.emplace_back([]{
+            PROFILE_ZONE("thread");
+            for(int i = 0; i < 50; ++i)
+                work(200);
+        });
+    for(auto &&t : threads)
+        t.join();
+
+    Profiler::report(std::cout);
+
+    std::ofstream trace("trace.json");
+    Profiler::exportChromeTrace(trace);
+    std::cout << "\nOpen trace.json in chrome://tracing or https://ui.perfetto.dev\n";
+    return 0;
+}
@@ -24,5 +24,10 @@ int main(){
     l.error("Error from main");
     l.fatal("Fatal from main");
 
+    // Structured fields, written as key=value in TEXT, or as JSON / logfmt
+    l.info("Request finished", LogFields().add("user", "alice").add("latency_us", 125), FUNC);
+    l.setFormat(TSLogger::Format::JSON);
+    l.info("Request finished", LogFields().add("user", "alice").add("latency_us", 125), FUNC);
+
     return 0;
 }
@@ -24,5 +24,17 @@ int main(){
     
     std::cout << std::endl;
 
+    // TSCTimer reads the CPU time stamp counter, cheap enough to time a handful of instructions
+    TSCTimer tsc;
+    volatile int sum = 0;
+    tsc.startTimer();
+    for(int i = 0; i < 100; ++i)
+        sum += i;
+    tsc.stopTimer();
+
+    std::cout << "Invariant TSC available: " << (TSC::available() ? "yes" : "no") << "\n";
+    std::cout << "100 additions (nanoseconds): " << tsc.nanoseconds() << "ns\n";
+    std::cout << "100 additions (TSC ticks): " << tsc.cycles() << "\n";
+
     return 0;
 }
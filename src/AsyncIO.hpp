@@ -0,0 +1,570 @@
+//
+//  AsyncIO.hpp
+//  cppcommon
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ThreadPool.hpp"
+#include "FSUtils.hpp"
+
+#if defined(__linux__)
+    #include <linux/io_uring.h>
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    // linux/fs.h defines BLOCK_SIZE, which breaks Mat.hpp when both are included
+    #undef BLOCK_SIZE
+#endif
+
+/**
+    \brief Asynchronous file I/O, batched through io_uring
+    \details Reads, writes, opens, closes, and (on Linux) statx calls are queued, then wait() hands
+    the whole batch to the kernel and collects the results, usually in a single syscall, so
+    loading thousands of small files takes a handful of syscalls instead of several per file.
+    Each operation completes with the syscall's result, bytes or an fd on success or -errno on
+    failure, passed to a callback or set on a std::future. Callbacks run inside wait() on the
+    calling thread, and may queue more operations, wait() returns once those are done too.
+    Futures are ready once wait() has returned. submit() starts a batch without waiting for it.\n
+    When io_uring isn't available (not Linux, a kernel older than 5.6, or disabled by seccomp or
+    kernel.io_uring_disabled) every operation runs as the plain blocking syscall on an internal
+    ThreadPool instead, starting as soon as it's queued, and callbacks run on the pool's threads.
+    usingUring() says which one is in use.\n
+    Like the ring it wraps, an AsyncIO is driven by one thread at a time. Buffers, and statx
+    results, have to stay valid until their operation completes; paths are copied. e.g. \n
+    AsyncIO io; \n
+    auto fd = io.open("a.txt", O_RDONLY); \n
+    io.wait(); \n
+    char buf[64]; \n
+    auto n = io.read(fd.get(), buf, sizeof(buf), 0); \n
+    io.wait(); \n
+    n.get(); \n
+    The destructor waits for everything queued.
+    \date 10-18-26
+*/
+class AsyncIO{
+public:
+    using Callback = std::function<void(int)>;
+
+    // Most bytes one read or write transfers, Linux's MAX_RW_COUNT, so the result always fits the
+    // int a callback gets
+    static constexpr size_t MAX_RW{0x7ffff000};
+
+    /**
+        \brief c'tor, sets up the ring
+        @param entries Submission queue size, more operations than this are submitted in pieces
+        @param use_uring False to always use the thread pool
+        @throws std::runtime_error if the ring is set up but can't be mapped
+    */
+    explicit AsyncIO(unsigned entries = 256, bool use_uring = true){
+#if defined(__linux__)
+        if(use_uring && setupRing(std::max(1u, entries)))
+            return;
+#else
+        (void)use_uring;
+#endif
+        sq_entries_ = std::max(1u, entries);
+        pool_.reset(new ThreadPool(std::max(2u, std::thread::hardware_concurrency())));
+    }
+
+    // Waits for everything queued. If the kernel rejects the submission the rest is abandoned
+    // rather than thrown from here, closing the ring cancels it
+    ~AsyncIO(){
+        try{
+            wait();
+        }
+        catch(std::runtime_error &){}
+        pool_.reset();
+#if defined(__linux__)
+        unmapRing();
+#endif
+    }
+
+    AsyncIO(const AsyncIO &) = delete;
+    AsyncIO &operator=(const AsyncIO &) = delete;
+
+    /**
+        \brief True if operations go through io_uring, false if they run on the thread pool
+    */
+    bool usingUring() const { return !pool_; }
+
+    /**
+        \brief Read up to len bytes at offset, like pread
+        \details As with pread the result can be short, at most MAX_RW bytes are read per call
+    */
+    void read(int fd, void *buf, size_t len, uint64_t offset, Callback done){
+        op_t *op = new op_t{std::move(done), {}};
+        len = std::min(len, MAX_RW);
+#if defined(__linux__)
+        if(!pool_){
+            io_uring_sqe *sqe = nextSqe(op);
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = fd;
+            sqe->addr = reinterpret_cast<uint64_t>(buf);
+            sqe->len = static_cast<unsigned>(len);
+            sqe->off = offset;
+            return;
+        }
+#endif
+        runOnPool(op, [=]{ return pread(fd, buf, len, static_cast<off_t>(offset)); });
+    }
+
+    std::future<int> read(int fd, void *buf, size_t len, uint64_t offset){
+        auto p = std::make_shared<std::promise<int>>();
+        read(fd, buf, len, offset, [p](int res){ p->set_value(res); });
+        return p->get_future();
+    }
+
+    /**
+        \brief Write up to len bytes at offset, like pwrite
+        \details As with pwrite the result can be short, at most MAX_RW bytes are written per call
+    */
+    void write(int fd, const void *buf, size_t len, uint64_t offset, Callback done){
+        op_t *op = new op_t{std::move(done), {}};
+        len = std::min(len, MAX_RW);
+#if defined(__linux__)
+        if(!pool_){
+            io_uring_sqe *sqe = nextSqe(op);
+            sqe->opcode = IORING_OP_WRITE;
+            sqe->fd = fd;
+            sqe->addr = reinterpret_cast<uint64_t>(buf);
+            sqe->len = static_cast<unsigned>(len);
+            sqe->off = offset;
+            return;
+        }
+#endif
+        runOnPool(op, [=]{ return pwrite(fd, buf, len, static_cast<off_t>(offset)); });
+    }
+
+    std::future<int> write(int fd, const void *buf, size_t len, uint64_t offset){
+        auto p = std::make_shared<std::promise<int>>();
+        write(fd, buf, len, offset, [p](int res){ p->set_value(res); });
+        return p->get_future();
+    }
+
+    /**
+        \brief Open a file, like open, the result is the new fd
+    */
+    void open(const std::string &path, int flags, mode_t mode, Callback done){
+        op_t *op = new op_t{std::move(done), path};
+#if defined(__linux__)
+        if(!pool_){
+            io_uring_sqe *sqe = nextSqe(op);
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = reinterpret_cast<uint64_t>(op->path_.c_str());
+            sqe->len = mode;
+            sqe->open_flags = static_cast<uint32_t>(flags);
+            return;
+        }
+#endif
+        runOnPool(op, [=]{ return ::open(op->path_.c_str(), flags, mode); });
+    }
+
+    std::future<int> open(const std::string &path, int flags, mode_t mode = 0){
+        auto p = std::make_shared<std::promise<int>>();
+        open(path, flags, mode, [p](int res){ p->set_value(res); });
+        return p->get_future();
+    }
+
+    /**
+        \brief Close an fd
+    */
+    void close(int fd, Callback done){
+        op_t *op = new op_t{std::move(done), {}};
+#if defined(__linux__)
+        if(!pool_){
+            io_uring_sqe *sqe = nextSqe(op);
+            sqe->opcode = IORING_OP_CLOSE;
+            sqe->fd = fd;
+            return;
+        }
+#endif
+        runOnPool(op, [=]{ return ::close(fd); });
+    }
+
+    std::future<int> close(int fd){
+        auto p = std::make_shared<std::promise<int>>();
+        close(fd, [p](int res){ p->set_value(res); });
+        return p->get_future();
+    }
+
+#if defined(__linux__)
+    /**
+        \brief statx a path, out is filled in when the result is 0
+        @param mask STATX_* fields wanted
+    */
+    void stat(const std::string &path, struct statx *out, unsigned mask, Callback done){
+        op_t *op = new op_t{std::move(done), path};
+        if(!pool_){
+            io_uring_sqe *sqe = nextSqe(op);
+            sqe->opcode = IORING_OP_STATX;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = reinterpret_cast<uint64_t>(op->path_.c_str());
+            sqe->len = mask;
+            sqe->off = reinterpret_cast<uint64_t>(out);
+            return;
+        }
+        runOnPool(op, [=]{ return statx(AT_FDCWD, op->path_.c_str(), 0, mask, out); });
+    }
+
+    std::future<int> stat(const std::string &path, struct statx *out,
+                          unsigned mask = STATX_BASIC_STATS){
+        auto p = std::make_shared<std::promise<int>>();
+        stat(path, out, mask, [p](int res){ p->set_value(res); });
+        return p->get_future();
+    }
+#endif
+
+    /**
+        \brief Hand everything queued so far to the kernel without waiting for it
+        @throws std::runtime_error if the kernel rejects the submission
+    */
+    void submit(){
+#if defined(__linux__)
+        if(!pool_)
+            enterRing(0);
+#endif
+    }
+
+    /**
+        \brief Submit everything queued and wait for all of it, and anything the callbacks queue,
+        to complete
+        @throws std::runtime_error if the kernel rejects the submission
+    */
+    void wait(){
+        if(pool_){
+            std::unique_lock<std::mutex> lock(mutex_);
+            idle_.wait(lock, [this]{ return in_flight_ == 0; });
+            return;
+        }
+#if defined(__linux__)
+        while(in_flight_)
+            if(!reap())
+                enterRing(in_flight_);
+#endif
+    }
+
+    /**
+        \brief Read whole files, batching the opens, reads, and closes of many files together
+        \details Each batch of files is opened and sized in one submission, read in a second, and
+        closed in a third, so the syscall count grows with the number of batches, not files. Files
+        that report the wrong size (e.g. in /proc) are finished with plain reads
+        @param paths Files to read
+        @return Contents of each file, in the same order as paths
+        @throws std::runtime_error if a file can't be opened or read
+    */
+    std::vector<std::string> readFiles(const std::vector<std::string> &paths){
+        std::vector<std::string> contents(paths.size());
+        const size_t batch = std::max<size_t>(1, sq_entries_ / 2);
+        for(size_t first = 0; first < paths.size(); first += batch){
+            size_t n = std::min(batch, paths.size() - first);
+            std::vector<int> fds(n, -1), got(n, -1);
+            std::vector<size_t> sizes(n, 0);
+            std::string error;
+
+#if defined(__linux__)
+            std::vector<struct statx> stx(n);
+#endif
+            for(size_t i = 0; i < n; ++i){
+                open(paths[first + i], O_RDONLY | O_CLOEXEC, 0, [&fds, i](int fd){ fds[i] = fd; });
+#if defined(__linux__)
+                stat(paths[first + i], &stx[i], STATX_SIZE, [&sizes, &stx, i](int res){
+                    if(res == 0)
+                        sizes[i] = static_cast<size_t>(stx[i].stx_size);
+                });
+#endif
+            }
+            wait();
+            for(size_t i = 0; i < n; ++i){
+#if !defined(__linux__)
+                struct stat st;
+                if(fds[i] >= 0 && fstat(fds[i], &st) == 0)
+                    sizes[i] = static_cast<size_t>(st.st_size);
+#endif
+                if(fds[i] < 0 && error.empty())
+                    error = "Couldn't open " + paths[first + i];
+            }
+
+            if(error.empty()){
+                for(size_t i = 0; i < n; ++i){
+                    contents[first + i].resize(sizes[i]);
+                    read(fds[i], &contents[first + i][0], sizes[i], 0,
+                         [&got, i](int res){ got[i] = res; });
+                }
+                wait();
+                for(size_t i = 0; i < n && error.empty(); ++i){
+                    if(got[i] < 0 || !readRest(fds[i], contents[first + i],
+                                               static_cast<size_t>(got[i])))
+                        error = "Couldn't read " + paths[first + i];
+                }
+            }
+
+            for(size_t i = 0; i < n; ++i)
+                if(fds[i] >= 0)
+                    close(fds[i], [](int){});
+            wait();
+            if(!error.empty())
+                throw std::runtime_error(error);
+        }
+        return contents;
+    }
+
+private:
+    struct op_t{
+        Callback done_;
+        // Kept here so it outlives the operation
+        std::string path_;
+    };
+
+    std::unique_ptr<ThreadPool> pool_;
+    unsigned sq_entries_{256};
+    // Queued or submitted, not yet completed
+    unsigned in_flight_{0};
+    // Only used with the pool, where operations finish on its threads
+    std::mutex mutex_;
+    std::condition_variable idle_;
+
+    template <class Syscall>
+    void runOnPool(op_t *op, Syscall call){
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++in_flight_;
+        }
+        pool_->push([this, op, call]{
+            int res = static_cast<int>(call());
+            if(res < 0)
+                res = -errno;
+            op->done_(res);
+            delete op;
+            std::lock_guard<std::mutex> lock(mutex_);
+            if(--in_flight_ == 0)
+                idle_.notify_all();
+        });
+    }
+
+    // Finish a read that came up short, got bytes are already in s
+    static bool readRest(int fd, std::string &s, size_t got){
+        // Zero sized files might still have contents
+        if(got == s.size() && got)
+            return true;
+        s.resize(got);
+        char buf[64 * 1024];
+        while(true){
+            ssize_t n = pread(fd, buf, sizeof(buf), static_cast<off_t>(s.size()));
+            if(n == 0)
+                return true;
+            if(n < 0){
+                if(errno == EINTR)
+                    continue;
+                return false;
+            }
+            s.append(buf, static_cast<size_t>(n));
+        }
+    }
+
+#if defined(__linux__)
+    int ring_fd_{-1};
+    void *sq_ring_{nullptr};
+    void *cq_ring_{nullptr};
+    size_t sq_ring_size_{0};
+    size_t cq_ring_size_{0};
+    io_uring_sqe *sqes_{nullptr};
+    unsigned *sq_head_{nullptr};
+    unsigned *sq_tail_{nullptr};
+    unsigned *sq_mask_{nullptr};
+    unsigned *sq_array_{nullptr};
+    unsigned *cq_head_{nullptr};
+    unsigned *cq_tail_{nullptr};
+    unsigned *cq_mask_{nullptr};
+    io_uring_cqe *cqes_{nullptr};
+    unsigned cq_entries_{0};
+    // Queued but not yet submitted
+    unsigned pending_{0};
+
+    // False if io_uring or one of the operations used here isn't supported
+    bool setupRing(unsigned entries){
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if(fd < 0)
+            return false;
+
+        std::vector<char> buf(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+        auto *probe = reinterpret_cast<io_uring_probe *>(buf.data());
+        if(syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) < 0){
+            ::close(fd);
+            return false;
+        }
+        for(int op : {IORING_OP_READ, IORING_OP_WRITE, IORING_OP_OPENAT, IORING_OP_CLOSE,
+                      IORING_OP_STATX}){
+            if(op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)){
+                ::close(fd);
+                return false;
+            }
+        }
+
+        ring_fd_ = fd;
+        sq_entries_ = params.sq_entries;
+        cq_entries_ = params.cq_entries;
+        sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if(single)
+            sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+
+        sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        fd, IORING_OFF_SQ_RING);
+        if(sq_ring_ == MAP_FAILED)
+            sq_ring_ = nullptr;
+        else if(single)
+            cq_ring_ = sq_ring_;
+        else{
+            cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if(cq_ring_ == MAP_FAILED)
+                cq_ring_ = nullptr;
+        }
+        void *sqes = mmap(nullptr, params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        sqes_ = sqes == MAP_FAILED ? nullptr : static_cast<io_uring_sqe *>(sqes);
+        if(!sq_ring_ || !cq_ring_ || !sqes_){
+            unmapRing();
+            throw std::runtime_error("Couldn't map the io_uring queues");
+        }
+
+        char *sq = static_cast<char *>(sq_ring_);
+        sq_head_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        sq_mask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        char *cq = static_cast<char *>(cq_ring_);
+        cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        cq_mask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    void unmapRing(){
+        if(sqes_)
+            munmap(sqes_, sq_entries_ * sizeof(io_uring_sqe));
+        if(cq_ring_ && cq_ring_ != sq_ring_)
+            munmap(cq_ring_, cq_ring_size_);
+        if(sq_ring_)
+            munmap(sq_ring_, sq_ring_size_);
+        sqes_ = nullptr;
+        sq_ring_ = cq_ring_ = nullptr;
+        if(ring_fd_ != -1)
+            ::close(ring_fd_);
+        ring_fd_ = -1;
+    }
+
+    // Next free, zeroed submission entry, for op
+    io_uring_sqe *nextSqe(op_t *op){
+        // Never more in flight than the completion queue holds
+        while(in_flight_ >= cq_entries_)
+            if(!reap())
+                enterRing(1);
+        unsigned tail = *sq_tail_;
+        if(tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) == sq_entries_)
+            enterRing(0);
+        unsigned idx = tail & *sq_mask_;
+        io_uring_sqe *sqe = &sqes_[idx];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->user_data = reinterpret_cast<uint64_t>(op);
+        sq_array_[idx] = idx;
+        // The caller fills the rest in before the next io_uring_enter, the kernel doesn't look
+        // at the queue until then
+        __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+        ++pending_;
+        ++in_flight_;
+        return sqe;
+    }
+
+    // Submit everything pending, and wait for at least min_complete completions
+    void enterRing(unsigned min_complete){
+        if(!pending_ && !min_complete)
+            return;
+        while(true){
+            unsigned flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+            int n = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd_, pending_, min_complete,
+                                             flags, nullptr, 0));
+            if(n >= 0){
+                pending_ -= std::min(pending_, static_cast<unsigned>(n));
+                if(!pending_)
+                    return;
+                continue;
+            }
+            // Busy means the completion queue is full, reaping makes room
+            if(errno == EBUSY)
+                reap();
+            else if(errno != EINTR && errno != EAGAIN)
+                throw std::runtime_error(std::string("io_uring_enter failed: ") + std::strerror(errno));
+        }
+    }
+
+    // Run the callbacks for every completion waiting, returns how many there were
+    unsigned reap(){
+        unsigned finished = 0;
+        while(true){
+            // Re-read every time, a callback can queue more and end up reaping too
+            unsigned head = *cq_head_;
+            if(head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE))
+                return finished;
+            io_uring_cqe *cqe = &cqes_[head & *cq_mask_];
+            op_t *op = reinterpret_cast<op_t *>(cqe->user_data);
+            int res = cqe->res;
+            __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+            --in_flight_;
+            ++finished;
+            op->done_(res);
+            delete op;
+        }
+    }
+#endif
+};
+
+// Lives here rather than in FSUtils so only code that wants io_uring pulls it in
+namespace FSUtils{
+    inline std::vector<FileInfo> fileInfo(const std::vector<std::string> &paths, AsyncIO &io);
+}
+
+/**
+    \brief fileInfo for many paths, with the statx calls batched through io
+    \details All the lookups are submitted together, see AsyncIO. Symlinks are followed. Without
+    statx (not Linux) this is the same as fileInfo(paths)
+    @param paths Paths to look up
+    @param io Engine to submit on, anything already queued on it is waited for too
+    @return One FileInfo per path, in the same order
+*/
+std::vector<FSUtils::FileInfo> FSUtils::fileInfo(const std::vector<std::string> &paths, AsyncIO &io){
+#if defined(__linux__)
+    std::vector<struct statx> stx(paths.size());
+    std::vector<FileInfo> infos(paths.size());
+    for(size_t i = 0; i < paths.size(); ++i)
+        io.stat(paths[i], &stx[i], STATX_BASIC_STATS, [&infos, &stx, i](int res){
+            if(res == 0)
+                infos[i] = fromStatx(stx[i]);
+        });
+    io.wait();
+    return infos;
+#else
+    (void)io;
+    return fileInfo(paths);
+#endif
+}
@@ -0,0 +1,340 @@
+//
+//  Benchmark.hpp
+//  cppcommon
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+#include <ostream>
+#include <sstream>
+#include <iomanip>
+#include <utility>
+#include <atomic>
+#include "Timer.hpp"
+#include "NumUtils.hpp"
+#include "PerfCounters.hpp"
+
+/**
+    \brief Result of a single benchmark
+    \details All times are per operation, in nanoseconds. counters_ holds any extra per operation
+    measurements (e.g. hardware counters) reported alongside the timings.
+*/
+struct benchresult_t{
+    std::string name_;
+    size_t iterations_{0};
+    size_t samples_{0};
+    double min_ns_{0};
+    double median_ns_{0};
+    double mean_ns_{0};
+    double p99_ns_{0};
+    double max_ns_{0};
+    double stddev_ns_{0};
+    double ops_per_sec_{0};
+    std::vector<std::pair<std::string, double>> counters_;
+};
+
+/**
+    \brief Statistical micro-benchmark harness built on Timer
+    \details For each benchmark: the function is run for the warm up period, the number of
+    iterations per sample is scaled until one sample takes at least the minimum sample time, then
+    the configured number of samples is taken. Reports min / median / mean / p99 / max / stddev per
+    operation and ops/sec, as a table, CSV, or JSON.\n
+    Use Benchmark::doNotOptimize on results and Benchmark::clobberMemory after writes so the
+    compiler can't delete the code being measured. e.g. \n
+    Benchmark b; \n
+    b.run("trim", [&]{ Benchmark::doNotOptimize(StrUtils::trim(str)); }); \n
+    b.printTable(std::cout);
+    \date 10-18-26
+*/
+class Benchmark{
+public:
+    /**
+        \brief Set how long each benchmark runs before measuring, default 100 milliseconds
+    */
+    Benchmark &warmup(std::chrono::milliseconds time){
+        warmup_ = time;
+        return *this;
+    }
+
+    /**
+        \brief Set how many samples are taken per benchmark, default 30
+    */
+    Benchmark &samples(size_t count){
+        samples_ = count ? count : 1;
+        return *this;
+    }
+
+    /**
+        \brief Set the minimum time a single sample has to take, default 10 milliseconds
+        \details Iterations per sample are scaled up until a sample takes at least this long, which
+        keeps timer overhead and resolution out of the per operation numbers
+    */
+    Benchmark &minSampleTime(std::chrono::milliseconds time){
+        min_sample_ = time;
+        return *this;
+    }
+
+    /**
+        \brief Also measure hardware counters for each benchmark, default off
+        \details After sampling, one more sample is run under PerfCounters and the per operation
+        cycles, instructions, IPC, cache misses, and branch misses are added to the result's
+        counters_. Counters the kernel won't provide are left out, see PerfCounters::error()
+    */
+    Benchmark &hardwareCounters(bool enable){
+        hw_counters_ = enable;
+        return *this;
+    }
+
+    /**
+        \brief Run and record a benchmark
+        @param name Name the benchmark is reported under
+        @param op Callable that performs exactly one operation
+        @return A copy of the result, also stored in results()
+    */
+    template <class F>
+    benchresult_t run(const std::string &name, F &&op){
+        return run(name, std::forward<F>(op), [](benchresult_t &, size_t){});
+    }
+
+    /**
+        \brief Run and record a benchmark, with hooks around the measured samples
+        \details measure(result, iterations) is called once after sampling with the iteration count
+        per sample, it can run op again under its own measurement and append to result.counters_
+        @param name Name the benchmark is reported under
+        @param op Callable that performs exactly one operation
+        @param measure Callable taking (benchresult_t &, size_t iterations)
+        @return A copy of the result, also stored in results()
+    */
+    template <class F, class M>
+    benchresult_t run(const std::string &name, F &&op, M &&measure){
+        auto warm_end = std::chrono::steady_clock::now() + warmup_;
+        while(std::chrono::steady_clock::now() < warm_end)
+            op();
+
+        size_t iters = scaleIterations(op);
+
+        std::vector<double> per_op;
+        per_op.reserve(samples_);
+        for(size_t s = 0; s < samples_; ++s)
+            per_op.push_back(timeIterations(op, iters) / static_cast<double>(iters));
+
+        benchresult_t res = summarize(name, iters, per_op);
+        measure(res, iters);
+        if(hw_counters_)
+            countHardware(op, iters, res);
+        results_.push_back(res);
+        return res;
+    }
+
+    /**
+        \brief All results recorded so far, in the order they were run
+    */
+    const std::vector<benchresult_t> &results() const { return results_; }
+
+    /**
+        \brief Human readable table of all results
+    */
+    void printTable(std::ostream &out) const {
+        out << std::left << std::setw(32) << "benchmark" << std::right
+            << std::setw(12) << "iters" << std::setw(12) << "min ns" << std::setw(12) << "median ns"
+            << std::setw(12) << "p99 ns" << std::setw(12) << "stddev ns" << std::setw(16) << "ops/sec"
+            << '\n';
+        for(auto &&r : results_){
+            out << std::left << std::setw(32) << r.name_ << std::right << std::fixed
+                << std::setprecision(2) << std::setw(12) << r.iterations_ << std::setw(12) << r.min_ns_
+                << std::setw(12) << r.median_ns_ << std::setw(12) << r.p99_ns_
+                << std::setw(12) << r.stddev_ns_ << std::setw(16) << std::setprecision(0)
+                << r.ops_per_sec_;
+            for(auto &&c : r.counters_)
+                out << "  " << c.first << "=" << std::setprecision(2) << c.second;
+            out << '\n';
+        }
+        out << std::defaultfloat << std::setprecision(6);
+    }
+
+    /**
+        \brief CSV of all results, one row per benchmark, counters as name=value in the last column
+    */
+    void writeCSV(std::ostream &out) const {
+        out << "name,iterations,samples,min_ns,median_ns,mean_ns,p99_ns,max_ns,stddev_ns,ops_per_sec,"
+            << "counters\n";
+        for(auto &&r : results_){
+            writeCSVField(out, r.name_);
+            out << ',' << r.iterations_ << ',' << r.samples_ << ',' << r.min_ns_
+                << ',' << r.median_ns_ << ',' << r.mean_ns_ << ',' << r.p99_ns_ << ',' << r.max_ns_
+                << ',' << r.stddev_ns_ << ',' << r.ops_per_sec_ << ',';
+            std::ostringstream counters;
+            for(size_t i = 0; i < r.counters_.size(); ++i)
+                counters << (i ? " " : "") << r.counters_[i].first << '=' << r.counters_[i].second;
+            writeCSVField(out, counters.str());
+            out << '\n';
+        }
+    }
+
+    /**
+        \brief JSON array of all results
+    */
+    void writeJSON(std::ostream &out) const {
+        out << "[\n";
+        for(size_t i = 0; i < results_.size(); ++i){
+            auto &&r = results_[i];
+            out << "  {\"name\":";
+            writeJSONString(out, r.name_);
+            out << ",\"iterations\":" << r.iterations_
+                << ",\"samples\":" << r.samples_ << ",\"min_ns\":" << r.min_ns_
+                << ",\"median_ns\":" << r.median_ns_ << ",\"mean_ns\":" << r.mean_ns_
+                << ",\"p99_ns\":" << r.p99_ns_ << ",\"max_ns\":" << r.max_ns_
+                << ",\"stddev_ns\":" << r.stddev_ns_ << ",\"ops_per_sec\":" << r.ops_per_sec_;
+            if(!r.counters_.empty()){
+                out << ",\"counters\":{";
+                for(size_t c = 0; c < r.counters_.size(); ++c){
+                    writeJSONString(out << (c ? "," : ""), r.counters_[c].first);
+                    out << ':' << (std::isfinite(r.counters_[c].second) ? r.counters_[c].second : 0.0);
+                }
+                out << '}';
+            }
+            out << '}' << (i + 1 < results_.size() ? "," : "") << '\n';
+        }
+        out << "]\n";
+    }
+
+    /**
+        \brief Force the compiler to treat value as used, so computing it can't be optimized away
+    */
+    template <class T>
+    static void doNotOptimize(const T &value){
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        static volatile const void *sink;
+        sink = &value;
+#endif
+    }
+
+    /**
+        \brief Force the compiler to assume all memory has been read and written
+    */
+    static void clobberMemory(){
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : : "memory");
+#else
+        std::atomic_signal_fence(std::memory_order_acq_rel);
+#endif
+    }
+
+private:
+    std::chrono::milliseconds warmup_{100};
+    std::chrono::milliseconds min_sample_{10};
+    size_t samples_{30};
+    bool hw_counters_{false};
+    std::vector<benchresult_t> results_;
+
+    // Quoted, with any " doubled
+    static void writeCSVField(std::ostream &out, const std::string &field){
+        out << '"';
+        for(char ch : field)
+            out << (ch == '"' ? "\"\"" : std::string(1, ch));
+        out << '"';
+    }
+
+    // Quoted and escaped the same way as TSLogger's JSON output
+    static void writeJSONString(std::ostream &out, const std::string &str){
+        static const char HEX[] = "0123456789abcdef";
+        out << '"';
+        for(char ch : str){
+            switch(ch){
+                case '"':  out << "\\\""; break;
+                case '\\': out << "\\\\"; break;
+                case '\n': out << "\\n"; break;
+                case '\r': out << "\\r"; break;
+                case '\t': out << "\\t"; break;
+                case '\b': out << "\\b"; break;
+                case '\f': out << "\\f"; break;
+                default:
+                    if(static_cast<unsigned char>(ch) < 0x20)
+                        out << "\\u00" << HEX[(static_cast<unsigned char>(ch) >> 4) & 0xF]
+                            << HEX[static_cast<unsigned char>(ch) & 0xF];
+                    else
+                        out << ch;
+                    break;
+            }
+        }
+        out << '"';
+    }
+
+    template <class F>
+    static void countHardware(F &op, size_t iters, benchresult_t &res){
+        PerfCounters pc;
+        if(!pc.available())
+            return;
+        pc.startCounters();
+        for(size_t i = 0; i < iters; ++i)
+            op();
+        pc.stopCounters();
+
+        for(int e = 0; e < PerfCounters::EVENT_COUNT; ++e){
+            auto event = static_cast<PerfCounters::Event>(e);
+            if(pc.available(event))
+                res.counters_.emplace_back(PerfCounters::name(event),
+                                           static_cast<double>(pc.value(event)) / iters);
+            if(event == PerfCounters::INSTRUCTIONS && pc.available(PerfCounters::CYCLES) && pc.available(event))
+                res.counters_.emplace_back("ipc", pc.ipc());
+        }
+    }
+
+    template <class F>
+    static double timeIterations(F &op, size_t iters){
+        Timer t;
+        t.startTimer();
+        for(size_t i = 0; i < iters; ++i)
+            op();
+        t.stopTimer();
+        return t.nanoseconds();
+    }
+
+    // Grow the iteration count until one sample takes at least min_sample_, at most 10x per step
+    template <class F>
+    size_t scaleIterations(F &op) const {
+        const double target = std::chrono::duration_cast<std::chrono::nanoseconds>(min_sample_).count();
+        size_t iters = 1;
+        while(true){
+            double elapsed = timeIterations(op, iters);
+            if(elapsed >= target)
+                return iters;
+            double grow = elapsed > 0 ? 1.2 * target / elapsed : 10.0;
+            grow = std::min(10.0, std::max(2.0, grow));
+            iters = static_cast<size_t>(std::ceil(iters * grow));
+        }
+    }
+
+    static benchresult_t summarize(const std::string &name, size_t iters, std::vector<double> &per_op){
+        benchresult_t r;
+        r.name_ = name;
+        r.iterations_ = iters;
+        r.samples_ = per_op.size();
+
+        auto min_max = NumUtils::minMaxInVec(per_op);
+        r.min_ns_ = min_max.first;
+        r.max_ns_ = min_max.second;
+        r.median_ns_ = NumUtils::getMedian(per_op);
+        r.mean_ns_ = std::accumulate(per_op.begin(), per_op.end(), 0.0) / per_op.size();
+
+        double sq = 0;
+        for(auto v : per_op)
+            sq += (v - r.mean_ns_) * (v - r.mean_ns_);
+        r.stddev_ns_ = per_op.size() > 1 ? std::sqrt(sq / (per_op.size() - 1)) : 0.0;
+
+        std::sort(per_op.begin(), per_op.end());
+        size_t p99 = static_cast<size_t>(std::ceil(0.99 * per_op.size()));
+        r.p99_ns_ = per_op[p99 ? p99 - 1 : 0];
+
+        r.ops_per_sec_ = r.median_ns_ > 0 ? 1e9 / r.median_ns_ : 0.0;
+        return r;
+    }
+};
@@ -0,0 +1,425 @@
+//
+//  CSVReader.hpp
+//  cppcommon
+//
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+#include <charconv>
+#include <cstring>
+#include <cstdlib>
+#include <type_traits>
+#include <sys/stat.h>
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+#include "MappedFile.hpp"
+
+/**
+    \brief One record from a CSVReader
+    \details Fields are views into the file or into the reader's buffer, they're only valid until the
+    reader moves to the next row. Copy them into strings to keep them.
+*/
+class CSVRow{
+public:
+    size_t size() const { return fields_.size(); }
+    bool empty() const { return fields_.empty(); }
+    std::string_view operator[](size_t col) const { return fields_[col]; }
+    std::vector<std::string_view>::const_iterator begin() const { return fields_.begin(); }
+    std::vector<std::string_view>::const_iterator end() const { return fields_.end(); }
+
+    /**
+        \brief Field col converted to T
+        \details T can be any integral or floating point type, std::string, or std::string_view.
+        Numbers must take up the whole field, surrounding spaces are allowed
+        @throws std::out_of_range if the row has no column col
+        @throws std::invalid_argument if the field isn't a valid T
+    */
+    template <class T>
+    T get(size_t col) const {
+        if(col >= fields_.size())
+            throw std::out_of_range("CSV row has no column " + std::to_string(col));
+        return convert<T>(fields_[col]);
+    }
+
+    /**
+        \brief Convert a single field to T, see get()
+        @throws std::invalid_argument if the field isn't a valid T
+    */
+    template <class T>
+    static T convert(std::string_view field){
+        if constexpr(std::is_same<T, std::string_view>::value)
+            return field;
+        else if constexpr(std::is_same<T, std::string>::value)
+            return std::string(field);
+        else{
+            static_assert(std::is_arithmetic<T>::value, "CSVRow::get needs a number or string type");
+            while(!field.empty() && field.front() == ' ')
+                field.remove_prefix(1);
+            while(!field.empty() && field.back() == ' ')
+                field.remove_suffix(1);
+            // from_chars doesn't take a leading '+'
+            if(field.size() > 1 && field.front() == '+')
+                field.remove_prefix(1);
+            T value{};
+            if(!parseNumber(field, value))
+                throw std::invalid_argument("Invalid CSV number: \"" + std::string(field) + "\"");
+            return value;
+        }
+    }
+
+private:
+    friend class CSVReader;
+    std::vector<std::string_view> fields_;
+
+    template <class T>
+    static bool parseNumber(std::string_view field, T &value){
+        const char *end = field.data() + field.size();
+        if constexpr(std::is_integral<T>::value){
+            auto res = std::from_chars(field.data(), end, value);
+            return !field.empty() && res.ec == std::errc() && res.ptr == end;
+        }
+        else{
+#if defined(__cpp_lib_to_chars)
+            auto res = std::from_chars(field.data(), end, value);
+            return !field.empty() && res.ec == std::errc() && res.ptr == end;
+#else
+            // No floating point from_chars, strtod needs a terminated copy
+            char buf[64];
+            if(field.empty() || field.size() >= sizeof(buf))
+                return false;
+            std::memcpy(buf, field.data(), field.size());
+            buf[field.size()] = '\0';
+            char *stop = nullptr;
+            value = static_cast<T>(std::strtod(buf, &stop));
+            return stop == buf + field.size();
+#endif
+        }
+    }
+};
+
+/**
+    \brief Streaming RFC 4180 CSV reader
+    \details Records end at LF or CRLF. Fields may be quoted, quoted fields can contain the
+    delimiter, newlines, and doubled quotes ("" for "). Characters after a closing quote, up to the
+    next delimiter, are kept as part of the field rather than rejected. Blank lines are skipped
+    unless skipBlankLines(false) is set, then each is a row with no fields.\n
+    Regular files are memory mapped and read one row at a time; unquoted fields (and quoted fields
+    without doubled quotes) are views straight into the file, only fields that need unescaping are
+    copied, into a buffer reused from row to row. Fields are found with SSE2 when available, 16
+    bytes at a time. e.g. \n
+    CSVReader csv("data.csv"); \n
+    csv.readHeader(); \n
+    while(csv.next()) \n
+        total += csv.row().get<double>(csv.column("price"));
+    \date 10-18-26
+*/
+class CSVReader{
+public:
+    /**
+        \brief Read a file
+        @param path The file, anything that isn't a regular file (e.g. a pipe) is read in full first
+        @param delim Field delimiter
+        @param quote Quote character
+        @throws std::runtime_error if the file can't be opened
+    */
+    explicit CSVReader(const std::string &path, char delim = ',', char quote = '"')
+        : delim_(delim)
+        , quote_(quote)
+    {
+        struct stat st;
+        if(stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode)){
+            file_ = MappedFile(path, MappedFile::SEQUENTIAL);
+            setText(file_.view());
+        }
+        else{
+            owned_.reset(new std::string(readAll(path)));
+            setText(*owned_);
+        }
+    }
+
+    /**
+        \brief Read CSV text held elsewhere, text has to outlive the reader
+    */
+    static CSVReader fromString(std::string_view text, char delim = ',', char quote = '"'){
+        return CSVReader(text_tag_t{}, text, delim, quote);
+    }
+
+    // Moving a reader invalidates the fields of its current row
+    CSVReader(CSVReader &&) = default;
+    CSVReader &operator=(CSVReader &&) = default;
+
+    /**
+        \brief Whether blank lines are skipped (the default) or read as rows with no fields
+    */
+    CSVReader &skipBlankLines(bool skip){
+        skip_blank_ = skip;
+        return *this;
+    }
+
+    /**
+        \brief Move to the next row
+        @return False once there are no more rows
+    */
+    bool next(){
+        while(skip_blank_ && atBlankLine())
+            skipLineEnd();
+        if(pos_ >= end_){
+            row_.fields_.clear();
+            return false;
+        }
+        if(atBlankLine()){
+            skipLineEnd();
+            row_.fields_.clear();
+        }
+        else
+            parseRow();
+        ++rows_;
+        return true;
+    }
+
+    /**
+        \brief The current row, valid until next() is called
+    */
+    const CSVRow &row() const { return row_; }
+
+    /**
+        \brief Number of rows read so far, including the header
+    */
+    size_t rowsRead() const { return rows_; }
+
+    /**
+        \brief Read the next row as the header, so columns can be looked up by name
+        @return False if there are no rows
+    */
+    bool readHeader(){
+        header_.clear();
+        if(!next())
+            return false;
+        for(auto field : row_)
+            header_.emplace_back(field);
+        return true;
+    }
+
+    /**
+        \brief Names from readHeader()
+    */
+    const std::vector<std::string> &header() const { return header_; }
+
+    /**
+        \brief Index of a column by its header name
+        @throws std::out_of_range if there's no such column
+    */
+    size_t column(std::string_view name) const {
+        for(size_t i = 0; i < header_.size(); ++i)
+            if(header_[i] == name)
+                return i;
+        throw std::out_of_range("No CSV column named " + std::string(name));
+    }
+
+    /**
+        \brief Read every remaining row, returning column col converted to T
+        @throws std::out_of_range if a row has no column col
+        @throws std::invalid_argument if a field isn't a valid T, see CSVRow::get
+    */
+    template <class T>
+    std::vector<T> readColumn(size_t col){
+        std::vector<T> values;
+        while(next())
+            values.push_back(row_.get<T>(col));
+        return values;
+    }
+
+    /**
+        \brief Read every remaining row, returning column name converted to T
+        @throws std::out_of_range if there's no such column
+        @throws std::invalid_argument if a field isn't a valid T, see CSVRow::get
+    */
+    template <class T>
+    std::vector<T> readColumn(std::string_view name){
+        return readColumn<T>(column(name));
+    }
+
+private:
+    struct span_t{
+        size_t start_;  // offset in the text, or in scratch_ when unescaped_
+        size_t len_;
+        bool unescaped_;
+    };
+
+    MappedFile file_;
+    std::unique_ptr<std::string> owned_;
+    const char *begin_{nullptr};
+    const char *pos_{nullptr};
+    const char *end_{nullptr};
+    char delim_;
+    char quote_;
+    bool skip_blank_{true};
+    size_t rows_{0};
+    CSVRow row_;
+    std::vector<span_t> spans_;
+    std::string scratch_;
+    std::vector<std::string> header_;
+    const char *block_{nullptr};
+    unsigned mask_{0};
+
+    struct text_tag_t{};
+
+    CSVReader(text_tag_t, std::string_view text, char delim, char quote)
+        : delim_(delim)
+        , quote_(quote)
+    {
+        setText(text);
+    }
+
+    void setText(std::string_view text){
+        begin_ = pos_ = text.data();
+        end_ = text.data() + text.size();
+    }
+
+    static std::string readAll(const std::string &path){
+        std::FILE *f = std::fopen(path.c_str(), "rb");
+        if(!f)
+            throw std::runtime_error("Couldn't open " + path);
+        std::string text;
+        char buf[64 * 1024];
+        size_t n;
+        while((n = std::fread(buf, 1, sizeof(buf), f)) > 0)
+            text.append(buf, n);
+        std::fclose(f);
+        return text;
+    }
+
+    // First delimiter, quote, '\r', or '\n' at or after p. The hit mask of the last 16 byte block is
+    // kept, fields are usually short so several are found from one load
+    const char *nextStructural(const char *p){
+#ifdef __SSE2__
+        while(true){
+            if(block_ && p >= block_ && p < block_ + 16){
+                unsigned hits = mask_ & (~0u << (p - block_));
+                if(hits)
+                    return block_ + __builtin_ctz(hits);
+                p = block_ + 16;
+            }
+            if(end_ - p < 16)
+                break;
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(delim_)),
+                                                     _mm_cmpeq_epi8(chunk, _mm_set1_epi8(quote_))),
+                                        _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')),
+                                                     _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'))));
+            block_ = p;
+            mask_ = static_cast<unsigned>(_mm_movemask_epi8(hits));
+        }
+#endif
+        for(; p < end_; ++p)
+            if(*p == delim_ || *p == quote_ || *p == '\r' || *p == '\n')
+                return p;
+        return end_;
+    }
+
+    // True if p ends a record: LF, CRLF, or the end of the text
+    bool atRecordEnd(const char *p) const {
+        return p >= end_ || *p == '\n' || (*p == '\r' && p + 1 < end_ && p[1] == '\n');
+    }
+
+    // End of an unquoted field: the next delimiter or record end. Quotes and lone '\r's are data
+    const char *fieldEnd(const char *p){
+        while(true){
+            const char *s = nextStructural(p);
+            if(s >= end_ || *s == delim_ || atRecordEnd(s))
+                return s;
+            p = s + 1;
+        }
+    }
+
+    bool atBlankLine() const {
+        return pos_ < end_ && (*pos_ == '\n' || (*pos_ == '\r' && pos_ + 1 < end_ && pos_[1] == '\n'));
+    }
+
+    void skipLineEnd(){
+        pos_ += *pos_ == '\n' ? 1 : 2;
+    }
+
+    void parseRow(){
+        spans_.clear();
+        scratch_.clear();
+        while(true){
+            const char *p = pos_;
+            span_t span{static_cast<size_t>(p - begin_), 0, false};
+            if(p < end_ && *p == quote_){
+                p = parseQuoted(p + 1, span);
+                // Anything between the closing quote and the delimiter is kept
+                const char *stop = fieldEnd(p);
+                if(stop > p)
+                    appendRange(span, p, stop);
+                p = stop;
+            }
+            else{
+                const char *stop = fieldEnd(p);
+                span.len_ = static_cast<size_t>(stop - p);
+                p = stop;
+            }
+            spans_.push_back(span);
+
+            if(p < end_ && *p == delim_){
+                pos_ = p + 1;
+                continue;
+            }
+            pos_ = p >= end_ ? end_ : p + (*p == '\n' ? 1 : 2);
+            break;
+        }
+
+        row_.fields_.clear();
+        for(auto &&s : spans_)
+            row_.fields_.emplace_back((s.unescaped_ ? scratch_.data() : begin_) + s.start_, s.len_);
+    }
+
+    // p is just after the opening quote, returns just after the closing quote. The field is a view
+    // of the text between the quotes unless a doubled quote forces a copy into scratch_
+    const char *parseQuoted(const char *p, span_t &span){
+        span.start_ = static_cast<size_t>(p - begin_);
+        while(true){
+            const char *q = static_cast<const char *>(std::memchr(p, quote_, static_cast<size_t>(end_ - p)));
+            if(!q){
+                // Unterminated, the rest of the text is the field
+                appendRange(span, p, end_);
+                return end_;
+            }
+            appendRange(span, p, q);
+            if(q + 1 < end_ && q[1] == quote_){
+                toScratch(span);
+                scratch_ += quote_;
+                ++span.len_;
+                p = q + 2;
+                continue;
+            }
+            return q + 1;
+        }
+    }
+
+    // Add [from, to) of the text to the field, which stays a plain view while it's contiguous
+    void appendRange(span_t &span, const char *from, const char *to){
+        if(!span.unescaped_ && begin_ + span.start_ + span.len_ == from){
+            span.len_ += static_cast<size_t>(to - from);
+            return;
+        }
+        toScratch(span);
+        scratch_.append(from, to);
+        span.len_ += static_cast<size_t>(to - from);
+    }
+
+    void toScratch(span_t &span){
+        if(span.unescaped_)
+            return;
+        size_t start = scratch_.size();
+        scratch_.append(begin_ + span.start_, span.len_);
+        span.start_ = start;
+        span.unescaped_ = true;
+    }
+};
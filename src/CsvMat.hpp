@@ -0,0 +1,168 @@
+//
+//  CsvMat.hpp
+//  cppcommon
+//
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
+#include "CSVReader.hpp"
+#include "FSUtils.hpp"
+#include "ThreadPool.hpp"
+#include "Mat.hpp"
+
+/**
+    \brief Loading csv files of numbers straight into a Mat
+    \details Kept apart from FSUtils so only code that wants a Mat pulls in Mat.hpp
+*/
+namespace FSUtils{
+    inline Mat loadNumericCsv(const std::string &filename, char delim = ',', bool header = false);
+    inline Mat loadNumericCsv(const std::string &filename, ThreadPool &pool, char delim = ',',
+                              bool header = false);
+}
+
+namespace{
+    inline void checkNumericCols(size_t found, size_t cols){
+        if(found != cols)
+            throw std::runtime_error("CSV row has " + std::to_string(found) + " columns, expected "
+                                     + std::to_string(cols));
+    }
+
+    // Parse every remaining row of csv as numbers onto the end of values. cols is the row width,
+    // taken from the first row when it's 0
+    inline size_t parseNumericRows(CSVReader &csv, std::vector<num_t> &values, size_t &cols){
+        size_t rows = 0;
+        while(csv.next()){
+            const CSVRow &row = csv.row();
+            if(!cols)
+                cols = row.size();
+            checkNumericCols(row.size(), cols);
+            for(auto field : row)
+                values.push_back(CSVRow::convert<num_t>(field));
+            ++rows;
+        }
+        return rows;
+    }
+
+    // Count the remaining rows of csv without converting them, cols as for parseNumericRows
+    inline size_t countNumericRows(CSVReader &csv, size_t &cols){
+        size_t rows = 0;
+        while(csv.next()){
+            if(!cols)
+                cols = csv.row().size();
+            checkNumericCols(csv.row().size(), cols);
+            ++rows;
+        }
+        return rows;
+    }
+
+    // Parse every remaining row of csv as numbers into out, which countNumericRows sized
+    inline void fillNumericRows(CSVReader &csv, num_t *out){
+        while(csv.next())
+            for(auto field : csv.row())
+                *out++ = CSVRow::convert<num_t>(field);
+    }
+}
+
+/**
+    \brief Load a csv of numbers straight into a Mat
+    \details Fields are parsed in place (see CSVReader) with std::from_chars, no string is created
+    per value. Every row must have the same number of columns
+    @param fileName File name if file is in cwd, else path to file
+    @param delim Field delimiter
+    @param header True to skip the first row
+    @return Mat with one row per csv row
+    @throws std::runtime_error if fileName can't be opened or the rows have different widths
+    @throws std::invalid_argument if a field isn't a number
+*/
+Mat FSUtils::loadNumericCsv(const std::string &fileName, char delim, bool header){
+    CSVReader csv(fileName, delim);
+    if(header)
+        csv.next();
+    std::vector<num_t> values;
+    size_t cols = 0;
+    size_t rows = parseNumericRows(csv, values, cols);
+    return Mat(std::move(values), rows, cols);
+}
+
+/**
+    \brief Load a csv of numbers straight into a Mat, parsing chunks of rows in parallel
+    \details As loadNumericCsv(fileName, delim, header), with newline aligned chunks of the file
+    parsed on pool. A first pass counts each chunk's rows, then every chunk converts its fields
+    straight into its own slice of the Mat's buffer, so nothing is copied after parsing. Chunks
+    are split on newlines without looking at quotes, so quoted fields must not contain newlines
+    (never the case for numbers). Small files are parsed on the calling thread. Don't call this
+    from a task running on the same pool
+    @param fileName File name if file is in cwd, else path to file
+    @param pool Pool to parse on
+    @param delim Field delimiter
+    @param header True to skip the first row
+    @return Mat with one row per csv row
+    @throws std::runtime_error if fileName can't be opened or the rows have different widths
+    @throws std::invalid_argument if a field isn't a number
+*/
+Mat FSUtils::loadNumericCsv(const std::string &fileName, ThreadPool &pool, char delim, bool header){
+    struct part_t{
+        size_t rows_{0};
+        size_t cols_{0};
+    };
+
+    LineRange all = lines(fileName);
+    std::string_view text = all.text();
+    auto chunks = splitLineChunks(text, parallelChunkCount(text.size()));
+    if(chunks.size() < 2){
+        CSVReader csv = CSVReader::fromString(text, delim);
+        if(header)
+            csv.next();
+        std::vector<num_t> values;
+        size_t cols = 0;
+        size_t rows = parseNumericRows(csv, values, cols);
+        return Mat(std::move(values), rows, cols);
+    }
+
+    auto reader = [&text, delim, header](std::string_view chunk){
+        CSVReader csv = CSVReader::fromString(chunk, delim);
+        if(header && chunk.data() == text.data())
+            csv.next();
+        return csv;
+    };
+    std::vector<part_t> parts;
+    for(auto &&r : runChunks<part_t>(chunks, pool, [&reader](std::string_view chunk){
+        part_t part;
+        CSVReader csv = reader(chunk);
+        part.rows_ = countNumericRows(csv, part.cols_);
+        return part;
+    }))
+        parts.push_back(r.get());
+
+    // Where each chunk's values start
+    std::vector<size_t> offsets;
+    size_t rows = 0, cols = 0;
+    for(auto &&p : parts){
+        offsets.push_back(rows * cols);
+        if(!p.rows_)
+            continue;
+        if(cols)
+            checkNumericCols(p.cols_, cols);
+        cols = p.cols_;
+        rows += p.rows_;
+    }
+
+    std::vector<num_t> values(rows * cols);
+    // Chunks are in file order, so each finds its slice by where it starts
+    auto slice = [&chunks, &offsets, &values](std::string_view chunk){
+        auto at = std::lower_bound(chunks.begin(), chunks.end(), chunk,
+                                   [](std::string_view a, std::string_view b){ return a.data() < b.data(); });
+        return values.data() + offsets[static_cast<size_t>(at - chunks.begin())];
+    };
+    for(auto &&r : runChunks<void>(chunks, pool, [&reader, &slice](std::string_view chunk){
+        CSVReader csv = reader(chunk);
+        fillNumericRows(csv, slice(chunk));
+    }))
+        r.get();
+    return Mat(std::move(values), rows, cols);
+}
@@ -0,0 +1,374 @@
+//
+//  DirWalker.hpp
+//  cppcommon
+//
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdexcept>
+#include <iterator>
+#include <cstring>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <unistd.h>
+
+/**
+    \brief Recursive directory walker, exposed as an input iterator
+    \details Each directory is opened relative to its parent's fd with openat, so the kernel never
+    resolves a full path, and entry types come from the d_type readdir already returns; fstatat is
+    only called when the filesystem doesn't fill d_type in (DT_UNKNOWN) or a symlink has to be
+    followed, and each directory entered is only fstat'ed when following symlinks, for the cycle
+    check. The path of the current entry is kept in one buffer that's appended to and truncated
+    as the walk moves, nothing is allocated per entry.\n
+    Options are set with chained calls before iterating, e.g. \n
+    for(auto &e : DirWalker("src").extension(".hpp").maxDepth(2)) \n
+        std::cout << e.path() << "\n"; \n
+    - maxDepth(n) - depth 0 is the root's own entries, directories at depth n aren't descended into \n
+    - extension(ext) / glob(pattern) - only yield non-directories whose name matches, the glob is
+    matched with fnmatch against the name, not the path \n
+    - includeFiles(bool) / includeDirs(bool) - which kinds of entries are yielded, directories
+    are always descended into \n
+    - symlinks(policy) - LIST yields links as SYMLINK entries without following them (default),
+    FOLLOW yields them as what they point to and descends into linked directories (a directory
+    already on the current path isn't entered again, so cycles end), SKIP leaves them out \n
+    - postOrder(bool) - yield each directory after its contents instead of before, what's needed
+    to delete a tree \n
+    The root itself isn't yielded. Subdirectories that can't be opened are skipped and counted in
+    errors(). Views in the entry are only valid until the iterator is advanced. A walker is single
+    pass, calling begin() again starts a new walk.
+    \date 10-18-26
+*/
+class DirWalker{
+public:
+    enum class Type{
+        FILE,
+        DIR,
+        SYMLINK,
+        OTHER
+    };
+
+    enum class Symlinks{
+        LIST,
+        FOLLOW,
+        SKIP
+    };
+
+    /**
+        \brief One entry of the walk, only valid until the iterator is advanced
+    */
+    class Entry{
+    public:
+        /**
+            \brief Path of the entry, starting with the walker's root
+        */
+        std::string_view path() const { return path_; }
+
+        /**
+            \brief path() relative to the walker's root
+        */
+        std::string_view relative() const { return path_.substr(rel_pos_); }
+
+        /**
+            \brief The last component of path()
+        */
+        std::string_view name() const { return name_; }
+
+        Type type() const { return type_; }
+        bool isFile() const { return type_ == Type::FILE; }
+        bool isDir() const { return type_ == Type::DIR; }
+        bool isSymlink() const { return type_ == Type::SYMLINK; }
+
+        /**
+            \brief Depth of the entry, 0 for the root's own entries
+        */
+        size_t depth() const { return depth_; }
+
+        /**
+            \brief fd of the directory holding the entry, for the *at calls with name()
+            \details Owned by the walker, don't close it
+        */
+        int dirFd() const { return dir_fd_; }
+
+    private:
+        friend class DirWalker;
+        std::string_view path_;
+        std::string_view name_;
+        Type type_{Type::OTHER};
+        size_t depth_{0};
+        size_t rel_pos_{0};
+        int dir_fd_{-1};
+    };
+
+    class iterator{
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Entry;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Entry *;
+        using reference = const Entry &;
+
+        iterator() = default;
+        explicit iterator(DirWalker *walker) : walker_(walker) {}
+
+        reference operator*() const { return walker_->entry_; }
+        pointer operator->() const { return &walker_->entry_; }
+
+        iterator &operator++(){
+            if(!walker_->advance())
+                walker_ = nullptr;
+            return *this;
+        }
+
+        bool operator==(const iterator &other) const { return walker_ == other.walker_; }
+        bool operator!=(const iterator &other) const { return !(*this == other); }
+
+    private:
+        DirWalker *walker_{nullptr};
+    };
+
+    /**
+        \brief Walker over everything below root
+        @param root Directory to walk, the root is followed if it's a symlink
+    */
+    explicit DirWalker(const std::string &root) : root_(root) {}
+
+    ~DirWalker() { closeAll(); }
+
+    DirWalker(const DirWalker &) = delete;
+    DirWalker &operator=(const DirWalker &) = delete;
+
+    DirWalker &maxDepth(size_t depth){
+        max_depth_ = depth;
+        return *this;
+    }
+
+    DirWalker &extension(const std::string &ext){
+        ext_ = ext;
+        return *this;
+    }
+
+    DirWalker &glob(const std::string &pattern){
+        glob_ = pattern;
+        return *this;
+    }
+
+    DirWalker &includeFiles(bool include){
+        files_ = include;
+        return *this;
+    }
+
+    DirWalker &includeDirs(bool include){
+        dirs_ = include;
+        return *this;
+    }
+
+    DirWalker &symlinks(Symlinks policy){
+        symlinks_ = policy;
+        return *this;
+    }
+
+    DirWalker &postOrder(bool post){
+        post_order_ = post;
+        return *this;
+    }
+
+    /**
+        \brief Start the walk
+        @throws std::runtime_error if the root can't be opened as a directory
+    */
+    iterator begin(){
+        closeAll();
+        errors_ = 0;
+        int fd = open(root_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if(fd == -1)
+            throw std::runtime_error("Couldn't open " + root_);
+        path_ = root_;
+        while(path_.size() > 1 && path_.back() == '/')
+            path_.pop_back();
+        rel_pos_ = path_.back() == '/' ? path_.size() : path_.size() + 1;
+        if(!push(fd, 0)){
+            close(fd);
+            throw std::runtime_error("Couldn't open " + root_);
+        }
+        return advance() ? iterator(this) : iterator();
+    }
+
+    iterator end() { return iterator(); }
+
+    /**
+        \brief Number of subdirectories that couldn't be opened during the last walk
+    */
+    size_t errors() const { return errors_; }
+
+private:
+    struct frame_t{
+        DIR *dir_;
+        int fd_;
+        // Length of path_ when it names this directory, and where its name starts
+        size_t path_len_;
+        size_t name_pos_;
+        dev_t dev_;
+        ino_t ino_;
+    };
+
+    std::string root_;
+    size_t max_depth_{static_cast<size_t>(-1)};
+    std::string ext_;
+    std::string glob_;
+    bool files_{true};
+    bool dirs_{true};
+    Symlinks symlinks_{Symlinks::LIST};
+    bool post_order_{false};
+
+    std::vector<frame_t> stack_;
+    std::string path_;
+    Entry entry_;
+    size_t rel_pos_{0};
+    size_t errors_{0};
+
+    static Type typeOf(mode_t mode){
+        if(S_ISREG(mode))
+            return Type::FILE;
+        if(S_ISDIR(mode))
+            return Type::DIR;
+        if(S_ISLNK(mode))
+            return Type::SYMLINK;
+        return Type::OTHER;
+    }
+
+    static Type typeOf(unsigned char d_type){
+        switch(d_type){
+            case DT_REG: return Type::FILE;
+            case DT_DIR: return Type::DIR;
+            case DT_LNK: return Type::SYMLINK;
+            default: return Type::OTHER;
+        }
+    }
+
+    // Only FOLLOW needs the directory's identity, to spot cycles
+    bool push(int fd, size_t name_pos){
+        struct stat st{};
+        if(symlinks_ == Symlinks::FOLLOW && fstat(fd, &st) != 0)
+            return false;
+        DIR *dir = fdopendir(fd);
+        if(!dir)
+            return false;
+        stack_.push_back({dir, fd, path_.size(), name_pos, st.st_dev, st.st_ino});
+        return true;
+    }
+
+    void closeAll(){
+        for(auto &f : stack_)
+            closedir(f.dir_);
+        stack_.clear();
+    }
+
+    bool onStack(dev_t dev, ino_t ino) const {
+        for(auto &f : stack_)
+            if(f.dev_ == dev && f.ino_ == ino)
+                return true;
+        return false;
+    }
+
+    bool matches(std::string_view name) const {
+        if(!ext_.empty() && (name.size() < ext_.size()
+                             || name.compare(name.size() - ext_.size(), ext_.size(), ext_) != 0))
+            return false;
+        if(!glob_.empty() && fnmatch(glob_.c_str(), name.data(), 0) != 0)
+            return false;
+        return true;
+    }
+
+    void setEntry(size_t name_pos, Type type, size_t depth, int dir_fd){
+        entry_.path_ = path_;
+        entry_.name_ = std::string_view(path_).substr(name_pos);
+        entry_.type_ = type;
+        entry_.depth_ = depth;
+        entry_.rel_pos_ = rel_pos_;
+        entry_.dir_fd_ = dir_fd;
+    }
+
+    // Move to the next entry to yield, false once the walk is done
+    bool advance(){
+        while(!stack_.empty()){
+            frame_t &top = stack_.back();
+            path_.resize(top.path_len_);
+            struct dirent *ent = readdir(top.dir_);
+
+            // Finished this directory, in post order it's yielded now that its contents are done
+            if(!ent){
+                size_t name_pos = top.name_pos_;
+                closedir(top.dir_);
+                stack_.pop_back();
+                if(post_order_ && dirs_ && !stack_.empty()){
+                    setEntry(name_pos, Type::DIR, stack_.size() - 1, stack_.back().fd_);
+                    return true;
+                }
+                continue;
+            }
+
+            const char *name = ent->d_name;
+            if(name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+                continue;
+
+            int dir_fd = top.fd_;
+            size_t depth = stack_.size() - 1;
+            Type type = typeOf(ent->d_type);
+            struct stat st;
+            if(ent->d_type == DT_UNKNOWN){
+                if(fstatat(dir_fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+                    continue;
+                type = typeOf(st.st_mode);
+            }
+            bool have_stat = false;
+            if(type == Type::SYMLINK){
+                if(symlinks_ == Symlinks::SKIP)
+                    continue;
+                // A dangling link stays a SYMLINK
+                if(symlinks_ == Symlinks::FOLLOW && fstatat(dir_fd, name, &st, 0) == 0){
+                    type = typeOf(st.st_mode);
+                    have_stat = true;
+                }
+            }
+
+            if(path_.back() != '/')
+                path_ += '/';
+            size_t name_pos = path_.size();
+            path_ += name;
+
+            if(type != Type::DIR){
+                if(!files_ || !matches(std::string_view(path_).substr(name_pos)))
+                    continue;
+                setEntry(name_pos, type, depth, dir_fd);
+                return true;
+            }
+
+            bool descended = false;
+            if(depth < max_depth_ && !(have_stat && onStack(st.st_dev, st.st_ino))){
+                int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+                if(!have_stat)
+                    flags |= O_NOFOLLOW;
+                int fd = openat(dir_fd, name, flags);
+                if(fd != -1 && push(fd, name_pos))
+                    descended = true;
+                else{
+                    if(fd != -1)
+                        close(fd);
+                    ++errors_;
+                }
+            }
+            // Post order directories that were descended into are yielded when they're finished
+            if(dirs_ && !(post_order_ && descended)){
+                setEntry(name_pos, Type::DIR, depth, dir_fd);
+                return true;
+            }
+        }
+        return false;
+    }
+};
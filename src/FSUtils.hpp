@@ -22,12 +22,36 @@
 #include <fstream>
 #include <cstdlib>
 #include <climits>
+#include <cerrno>
+#include <future>
+#include <thread>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <deque>
+#include <exception>
 #include "StrUtils.hpp"
+#include "MappedFile.hpp"
+#include "LineRange.hpp"
+#include "ThreadPool.hpp"
+#include "CSVReader.hpp"
+#include "DirWalker.hpp"
 
 // Windows stat
 #ifdef WIN32
     #define stat _stat
 #endif
+
+// Kernel side copies for copyf
+#ifdef __linux__
+    #include <sys/ioctl.h>
+    #include <sys/sendfile.h>
+    #include <linux/fs.h>
+    // linux/fs.h defines BLOCK_SIZE, which breaks Mat.hpp when both are included
+    #undef BLOCK_SIZE
+    // makedev, to give statx's device numbers as an st_dev
+    #include <sys/sysmacros.h>
+#endif
 /**
     \brief Utility functions related to the file system
     \details FSUtils completely includes the older FileUtils namespace. In order to continue to use
@@ -39,7 +63,15 @@
 namespace FSUtils{
     inline std::string readFullFile(const std::string &filename);
     inline std::vector<std::string> readLineByLine(const std::string &filename);
+    inline LineRange lines(const std::string &filename);
     inline size_t lineCount(const std::string &filename);
+    inline size_t lineCount(const std::string &filename, ThreadPool &pool);
+    inline std::vector<std::string_view> splitLineChunks(std::string_view text, size_t chunks);
+    template <class F>
+    void parallelLines(const std::string &filename, ThreadPool &pool, F fn);
+    template <class T, class Accumulate, class Combine>
+    T parallelLines(const std::string &filename, ThreadPool &pool, T init, Accumulate acc,
+                    Combine combine);
     inline std::vector<std::string> getFilesInDir(const std::string &dirpath,
                                                   const std::string &ext = "");
     inline std::vector<std::string> getDirsInDir(const std::string &path);
@@ -54,17 +86,82 @@ namespace FSUtils{
     inline bool deleteDir(const std::string &dirpath);
     inline bool movef(const std::string &curpath, const std::string &newpath);
     inline bool moved(const std::string &curpath, const std::string &newpath);
-    inline bool copyf(const std::string &curpath, const std::string &newpath);
+    inline bool copyf(const std::string &curpath, const std::string &newpath, bool preserve = false);
     inline bool copyd(const std::string &curpath, const std::string &newpath);
+    struct TreeProgress;
+    using TreeProgressFn = std::function<void(const TreeProgress &)>;
+    inline TreeProgress scanDir(const std::string &dirpath, ThreadPool &pool,
+                                const TreeProgressFn &progress = nullptr, size_t max_open = 16);
+    inline bool deleteDir(const std::string &dirpath, ThreadPool &pool,
+                          const TreeProgressFn &progress = nullptr, size_t max_open = 16);
+    inline bool copyd(const std::string &curpath, const std::string &newpath, ThreadPool &pool,
+                      const TreeProgressFn &progress = nullptr, size_t max_open = 16);
     inline float fsize(const std::string &filepath, const std::string &order = "b");
     inline std::vector<std::vector<std::string>> csvToMatrix(const std::string &filename);
     inline void appendToFile(const std::string &filepath, const std::string &msg);
     inline std::string getWorkingDir();
+    struct FileInfo;
+    inline FileInfo fileInfo(const std::string &path, bool follow = true);
+    inline std::vector<FileInfo> fileInfo(const std::vector<std::string> &paths, bool follow = true);
     inline std::string getPermissions(const std::string &path);
     inline std::string getModifiedTime(const std::string &path);
     inline std::string getAccessTime(const std::string &path);
     inline bool clearFile(const std::string &path);
     
+    // Files smaller than this aren't worth splitting across threads
+    const size_t MIN_PARALLEL_CHUNK{1024 * 1024};
+    
+    /**
+        \brief How far a parallel tree operation has got, see scanDir
+    */
+    struct TreeProgress{
+        size_t dirs_{0};
+        // Everything that isn't a directory
+        size_t files_{0};
+        // Total size of the files, only counted by scanDir
+        size_t bytes_{0};
+        // Subdirectories that couldn't be opened, so nothing below them was visited
+        size_t skipped_{0};
+    };
+    
+    /**
+        \brief What one stat call says about a path, see fileInfo
+    */
+    struct FileInfo{
+        enum Type{
+            NONE,
+            FILE,
+            DIR,
+            SYMLINK,
+            OTHER
+        };
+        
+        // NONE if the path couldn't be stat'ed
+        Type type_{NONE};
+        uint64_t size_{0};
+        // Type and permission bits, as st_mode
+        uint32_t mode_{0};
+        uint64_t inode_{0};
+        // Device holding the file, as st_dev
+        uint64_t dev_{0};
+        struct timespec mtime_{0, 0};
+        struct timespec atime_{0, 0};
+        struct timespec ctime_{0, 0};
+        
+        bool exists() const { return type_ != NONE; }
+        bool isFile() const { return type_ == FILE; }
+        bool isDir() const { return type_ == DIR; }
+        bool isSymlink() const { return type_ == SYMLINK; }
+        // rwx bits for user, group, and others
+        uint32_t permissions() const { return mode_ & 0777; }
+        int64_t mtimeNs() const { return int64_t(mtime_.tv_sec) * 1000000000 + mtime_.tv_nsec; }
+        // Same file with the same contents as far as stat can tell: inode, size and mtime to the ns
+        bool sameVersion(const FileInfo &other) const {
+            return type_ == other.type_ && inode_ == other.inode_ && dev_ == other.dev_
+                && size_ == other.size_ && mtimeNs() == other.mtimeNs();
+        }
+    };
+    
     const std::string THIS_DIR_DOT{"."};
     const std::string PREV_DIR_DOT{".."};
 }
@@ -76,48 +173,82 @@ namespace FSUtils{
 
 /**
     \brief Read full file into a single string
-    \details Will read a full file, all content, into a single string
+    \details Will read a full file, all content, into a single string. The file is read straight into
+    the string, peak memory is the size of the file. Use MappedFile to work on a file in place
+    without reading it at all
     @param fileName File name if file is in cwd, else path to file
     @return The full file as a string
-    @throws std::runtime_error if fileName can't be opened
+    @throws std::runtime_error if fileName can't be opened or read
 */
 std::string FSUtils::readFullFile(const std::string &fileName){
-    std::ifstream ifs(fileName, std::ios::in | std::ios::binary | std::ios::ate);
-    if(!ifs.is_open())
+    int fd = open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd == -1)
         throw std::runtime_error("Couldn't open " + fileName);
     
-    std::ifstream::pos_type f_size = ifs.tellg();
-    ifs.seekg(0, std::ios::beg);
-    
-    std::vector<char> bytes(f_size);
-    ifs.read(bytes.data(), f_size);
+    // Size is only a hint, pipes and /proc files report 0 and a file can change while it's read
+    struct stat st;
+    size_t expected = 0;
+    if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+        expected = static_cast<size_t>(st.st_size);
     
-    return std::string(bytes.data(), f_size);
+    std::string contents;
+    contents.resize(expected ? expected : 16 * 1024);
+    size_t used = 0;
+    while(true){
+        if(used == contents.size())
+            contents.resize(contents.size() * 2);
+        ssize_t n = read(fd, &contents[used], contents.size() - used);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n < 0){
+            close(fd);
+            throw std::runtime_error("Couldn't read " + fileName);
+        }
+        if(n == 0)
+            break;
+        used += static_cast<size_t>(n);
+        // Don't double the buffer just to find EOF on a regular file
+        if(used == expected)
+            break;
+    }
+    close(fd);
+    contents.resize(used);
+    return contents;
 }
 
 /**
     \brief Read file into vector<string> of lines 
-    \details Will read the full file then proceed to split it into a vector<string> of lines
+    \details Will read the full file then proceed to split it into a vector<string> of lines, a
+    trailing '\r' is dropped from each line. Use lines() instead when views of the lines will do
     @param fileName File name if file is in cwd, else path to file
     @return A vector of strings which represent the lines of the file
     @throws std::runtime_error if fileName can't be opened
 */
 std::vector<std::string> FSUtils::readLineByLine(const std::string &fileName){
-    std::string line;
-    std::ifstream in(fileName);
-    if(!in.is_open())
-        throw std::runtime_error("Couldn't open " + fileName);
-        
     std::vector<std::string> vec;
-    vec.reserve(lineCount(fileName));
-    
-    while(std::getline(in, line))
-        vec.push_back(line);
-        
+    for(std::string_view line : lines(fileName))
+        vec.emplace_back(line);
     vec.shrink_to_fit();
     return vec;
 }
 
+/**
+    \brief Lazy range over the lines of a file, without copying them
+    \details Regular files are memory mapped, anything else (pipes, /proc files) is read in full
+    first. See LineRange for how lines are split, e.g. \n
+    for(std::string_view line : FSUtils::lines("big.log")) \n
+        ...
+    @param fileName File name if file is in cwd, else path to file
+    @return The lines, views into the range which must outlive them
+    @throws std::runtime_error if fileName can't be opened
+*/
+LineRange FSUtils::lines(const std::string &fileName){
+    struct stat st;
+    if(stat(fileName.c_str(), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+        return LineRange(MappedFile(fileName, MappedFile::SEQUENTIAL));
+    return LineRange(readFullFile(fileName));
+}
+
 /**
     \brief Returns number of lines in a file
     \details This code comes almost letter for letter from the "wc" utility, I am not the author and 
@@ -150,6 +281,152 @@ size_t FSUtils::lineCount(const std::string &fileName){
     return lines;
 }
 
+namespace{
+    // How many chunks to split size bytes into, a few per core so uneven chunks balance out
+    inline size_t parallelChunkCount(size_t size){
+        size_t cores = std::max(1u, std::thread::hardware_concurrency());
+        return std::max<size_t>(1, std::min(cores * 4, size / FSUtils::MIN_PARALLEL_CHUNK));
+    }
+    
+    // Every task refers to the caller's stack, so all of them have to finish before an exception
+    // from one (or from pushing) can leave the caller
+    template <class R, class Task>
+    std::vector<std::future<R>> runChunks(const std::vector<std::string_view> &chunks, ThreadPool &pool,
+                                          Task task){
+        std::vector<std::future<R>> results;
+        results.reserve(chunks.size());
+        try{
+            for(auto chunk : chunks)
+                results.push_back(pool.push(task, chunk));
+        }
+        catch(...){
+            for(auto &&r : results)
+                r.wait();
+            throw;
+        }
+        for(auto &&r : results)
+            r.wait();
+        return results;
+    }
+}
+
+/**
+    \brief Returns number of lines in a file, counting chunks of it in parallel
+    \details Same count as lineCount(fileName), the number of '\n' characters. The file is memory
+    mapped and split into chunks counted on pool; small files are counted on the calling thread.
+    Don't call this from a task running on the same pool
+    @param fileName File name if file is in cwd, else path to file
+    @param pool Pool to count on
+    @return Number of lines in the file
+    @throws std::runtime_error if fileName can't be opened
+*/
+size_t FSUtils::lineCount(const std::string &fileName, ThreadPool &pool){
+    LineRange all = lines(fileName);
+    auto count = [](std::string_view chunk){
+        return static_cast<size_t>(std::count(chunk.begin(), chunk.end(), '\n'));
+    };
+    auto chunks = splitLineChunks(all.text(), parallelChunkCount(all.text().size()));
+    if(chunks.size() < 2)
+        return count(all.text());
+    size_t total = 0;
+    for(auto &&r : runChunks<size_t>(chunks, pool, count))
+        total += r.get();
+    return total;
+}
+
+/**
+    \brief Split text into about chunks pieces that each end just after a newline
+    \details Every line is entirely within one chunk, so each chunk can be handed to a LineRange on
+    its own. A line longer than a chunk makes its chunk longer, so there can be fewer chunks than
+    asked for
+    @param text The text to split
+    @param chunks Number of chunks wanted
+    @return Views into text, in order
+*/
+std::vector<std::string_view> FSUtils::splitLineChunks(std::string_view text, size_t chunks){
+    std::vector<std::string_view> out;
+    if(text.empty())
+        return out;
+    chunks = std::max<size_t>(1, chunks);
+    size_t target = text.size() / chunks;
+    size_t start = 0;
+    while(start < text.size()){
+        size_t stop = std::min(text.size(), start + std::max<size_t>(1, target));
+        if(stop < text.size()){
+            const void *nl = std::memchr(text.data() + stop - 1, '\n', text.size() - stop + 1);
+            stop = nl ? static_cast<size_t>(static_cast<const char *>(nl) - text.data()) + 1 : text.size();
+        }
+        out.push_back(text.substr(start, stop - start));
+        start = stop;
+    }
+    return out;
+}
+
+/**
+    \brief Call fn on every line of a file, in parallel
+    \details The file is memory mapped (see lines()), split into newline aligned chunks, and each
+    chunk's lines are passed to fn on pool. fn is called concurrently from several threads and in no
+    particular order, it has to be thread safe. Returns once every line has been processed. Small
+    files are processed on the calling thread. Don't call this from a task running on the same pool
+    @param fileName File name if file is in cwd, else path to file
+    @param pool Pool to run on
+    @param fn Callable taking a std::string_view line, only valid during the call
+    @throws std::runtime_error if fileName can't be opened, rethrows the first exception from fn
+*/
+template <class F>
+void FSUtils::parallelLines(const std::string &fileName, ThreadPool &pool, F fn){
+    LineRange all = lines(fileName);
+    auto chunks = splitLineChunks(all.text(), parallelChunkCount(all.text().size()));
+    auto task = [&fn](std::string_view chunk){
+        for(std::string_view line : LineRange(chunk))
+            fn(line);
+    };
+    if(chunks.size() < 2){
+        task(all.text());
+        return;
+    }
+    for(auto &&r : runChunks<void>(chunks, pool, task))
+        r.get();
+}
+
+/**
+    \brief Aggregate every line of a file in parallel, combining the results in file order
+    \details Each chunk (see the other overload) starts from a copy of init and calls
+    acc(partial, line) for each of its lines, in order. The partial results are then folded on the
+    calling thread in file order, result = combine(std::move(result), std::move(partial)), starting
+    from init. So init has to be an identity for combine (0 for a sum, an empty container for
+    concatenation); combine doesn't need to be commutative. acc is called concurrently from several
+    threads and has to be thread safe. Don't call this from a task running on the same pool. e.g.\n
+    size_t errors = FSUtils::parallelLines(path, pool, size_t{0},\n
+        [](size_t &n, std::string_view line){ n += line.find("ERROR") != std::string_view::npos; },\n
+        [](size_t a, size_t b){ return a + b; });
+    @param fileName File name if file is in cwd, else path to file
+    @param pool Pool to run on
+    @param init Starting value of every chunk and of the result
+    @param acc Callable taking (T &partial, std::string_view line)
+    @param combine Callable taking (T &&result, T &&partial), returning the new result
+    @return The combined result
+    @throws std::runtime_error if fileName can't be opened, rethrows the first exception from acc
+*/
+template <class T, class Accumulate, class Combine>
+T FSUtils::parallelLines(const std::string &fileName, ThreadPool &pool, T init, Accumulate acc,
+                         Combine combine){
+    LineRange all = lines(fileName);
+    auto chunks = splitLineChunks(all.text(), parallelChunkCount(all.text().size()));
+    auto task = [&init, &acc](std::string_view chunk){
+        T partial = init;
+        for(std::string_view line : LineRange(chunk))
+            acc(partial, line);
+        return partial;
+    };
+    T result = init;
+    if(chunks.size() < 2)
+        return combine(std::move(result), task(all.text()));
+    for(auto &&r : runChunks<T>(chunks, pool, task))
+        result = combine(std::move(result), r.get());
+    return result;
+}
+
 /**
     \brief Get a list of files in directory
     @param dirPath Path to the directory in question
@@ -158,30 +435,13 @@ size_t FSUtils::lineCount(const std::string &fileName){
     @throws std::runtime_error if dirPath can't be opened
 */
 std::vector<std::string> FSUtils::getFilesInDir(const std::string &dirPath, const std::string &ext){
-        std::vector<std::string> files;
-        
-    DIR *dir;
-    struct dirent *ent;
+    std::vector<std::string> files;
+    DirWalker walk(dirPath);
+    walk.maxDepth(0).includeDirs(false).extension(ext).symlinks(DirWalker::Symlinks::FOLLOW);
     
-    if((dir = opendir(dirPath.c_str())) == NULL)
-        throw std::runtime_error("Couldn't open " + dirPath);
-        
-    // print all the files and directories within directory
-    while ((ent = readdir(dir)) != NULL) {
-        if(isFile(std::string(dirPath + "/" + ent->d_name))){
-            // Only add files with the requested file extension
-            if(ext != ""){
-                // Note: This can easily be fooled
-                std::string f_name(ent->d_name);
-                if(StrUtils::endsWithString(f_name, ext))
-                    files.push_back(f_name);
-            }
-            // Don't care what the file extension is
-            else
-                files.emplace_back(ent->d_name);
-        }
-    }
-    closedir(dir);
+    for(auto &e : walk)
+        if(e.isFile())
+            files.emplace_back(e.name());
     
     return files;
 }
@@ -195,19 +455,11 @@ std::vector<std::string> FSUtils::getFilesInDir(const std::string &dirPath, cons
 */
 std::vector<std::string> FSUtils::getDirsInDir(const std::string &path){
     std::vector<std::string> dirs;
-    DIR *dir;
-    struct dirent *ent;
+    DirWalker walk(path);
+    walk.maxDepth(0).includeFiles(false).symlinks(DirWalker::Symlinks::FOLLOW);
     
-    if((dir = opendir(path.c_str())) == NULL)
-        throw std::runtime_error("Couldn't open " + path);
-    
-    while((ent = readdir(dir)) != NULL){
-        std::string it = ent->d_name;
-        if(THIS_DIR_DOT == it || PREV_DIR_DOT == it)
-            continue;
-        if(isDir(std::string(path + "/" + it)))
-            dirs.emplace_back(it);
-    }
+    for(auto &e : walk)
+        dirs.emplace_back(e.name());
 
     return dirs;
 }
@@ -334,6 +586,7 @@ bool FSUtils::deleteFile(const std::string &filepath){
 
 /**
     \brief Delete a directory and contents
+    \details Symlinks inside the directory are removed, what they point to is left alone
     @param dirpath The path to the directory
     @return True if the directory does not exist at the end of the function
     @throws std::runtime_error if dirpath can't be opened
@@ -342,39 +595,19 @@ bool FSUtils::deleteDir(const std::string &dirpath){
     if(!dexists(dirpath))
         return true;
     
-    DIR *dir;
-    struct dirent *ent;
-    
-    if((dir = opendir(dirpath.c_str())) == NULL)
+    // Contents before the directories holding them, symlinks are removed, not followed
+    DirWalker walk(dirpath);
+    walk.postOrder(true);
+    try{
+        for(auto &e : walk)
+            unlinkat(e.dirFd(), e.name().data(), e.isDir() ? AT_REMOVEDIR : 0);
+    }
+    catch(std::runtime_error &){
         throw std::runtime_error("Couldn't open " + dirpath + " for deletion");
-    
-    while((ent = readdir(dir)) != NULL){
-        std::string it(ent->d_name);
-        
-        // Be very careful not to traverse vertically out of the directory
-        if(THIS_DIR_DOT == it || PREV_DIR_DOT == it)
-            continue;
-        
-        std::string relative_it(dirpath + "/" + it);
-        
-        if(isDir(relative_it)){
-            // This really shouldn't ever be the case, since we couldn't be in this loop
-            if(dempty(relative_it))
-                std::remove(relative_it.c_str());
-            // Make the recursive call
-            else
-                deleteDir(relative_it);
-        }
-        // Remove all the files from the directory
-        else if(isFile(relative_it))
-            std::remove(relative_it.c_str());
-        else
-            throw std::runtime_error("Is that a symlink?? Uh...not implemented!");
     }
-    closedir(dir);
     
-    if(isDir(dirpath) && dempty(dirpath))
-        std::remove(dirpath.c_str());
+    if(isDir(dirpath))
+        rmdir(dirpath.c_str());
     
     return !dexists(dirpath);
 }
@@ -398,73 +631,183 @@ bool FSUtils::movef(const std::string &curpath, const std::string &newpath){
     \brief Move a directory
     @param curpath The current path to the directory
     @param newpath Where to move the file
-    @return True if the directory is successfully moved
+    @return True if the directory is successfully moved, false if anything in it couldn't be
+    renamed (it's left under curpath, along with the directories holding it)
     @throws std::runtime_error if curpath can't be opened or if newpath can't be created
 */
 bool FSUtils::moved(const std::string &curpath, const std::string &newpath){
     if(!dexists(curpath) || !isDir(curpath))
         return false;
     
-    DIR *dir;
-    struct dirent *ent;
-    
-    if((dir = opendir(curpath.c_str())) == NULL)
-        throw std::runtime_error("Couldn't open " + curpath);
-    
+    DirWalker walk(curpath);
     if(!makeDir(newpath))
         throw std::runtime_error("Failed to create " + newpath);
     
-    while((ent = readdir(dir)) != NULL){
-        std::string it(ent->d_name);
-        
-        if(THIS_DIR_DOT == it || PREV_DIR_DOT == it)
-            continue;
-        
-        std::string cur_item(curpath + "/" + it);
-        std::string new_item(newpath + "/" + it);
-        
-        if(isFile(cur_item))
-            movef(cur_item, new_item);
-        else if(isDir(cur_item))
-            moved(cur_item, new_item);
-        else
-            throw std::runtime_error("Is that a symlink?? Uh...not implemented!");
+    std::string new_item(newpath + "/");
+    const size_t base = new_item.size();
+    bool moved_all = true;
+    for(auto &e : walk){
+        new_item.resize(base);
+        new_item += e.relative();
+        if(e.isDir()){
+            if(!makeDir(new_item))
+                throw std::runtime_error("Failed to create " + new_item);
+        }
+        else if(renameat(e.dirFd(), e.name().data(), AT_FDCWD, new_item.c_str()) != 0)
+            moved_all = false;
     }
-    closedir(dir);
     
-    if(isDir(curpath) && dempty(curpath))
-        std::remove(curpath.c_str());
+    // Remove the emptied directories, anything that couldn't be moved keeps its directory
+    DirWalker emptied(curpath);
+    emptied.postOrder(true).includeFiles(false);
+    for(auto &e : emptied)
+        unlinkat(e.dirFd(), e.name().data(), AT_REMOVEDIR);
+    rmdir(curpath.c_str());
 
-    return dexists(newpath);
+    return moved_all && walk.errors() == 0 && dexists(newpath);
+}
+
+namespace{
+    // Copy size bytes from in to out, both at offset 0, without going through user space where
+    // the kernel allows it: a reflink shares the blocks (btrfs, XFS), copy_file_range copies
+    // inside the kernel (and on NFS/SMB on the server), sendfile at least skips the user space
+    // buffer. Each falls through to the next if the filesystem doesn't support it
+    inline bool copyContents(int in, int out, size_t size){
+#ifdef __linux__
+    #ifdef FICLONE
+        if(ioctl(out, FICLONE, in) == 0)
+            return true;
+    #endif
+        size_t done = 0;
+        while(done < size){
+            ssize_t n = copy_file_range(in, nullptr, out, nullptr, size - done, 0);
+            if(n <= 0)
+                break;
+            done += static_cast<size_t>(n);
+        }
+        while(done < size){
+            off_t off = static_cast<off_t>(done);
+            ssize_t n = sendfile(out, in, &off, size - done);
+            if(n <= 0)
+                break;
+            done += static_cast<size_t>(n);
+        }
+        // Files in /proc and the like claim to be empty, only read() gets their contents
+        if(size && done == size)
+            return true;
+        // Whatever was copied so far is kept, read/write picks up from there
+        if(lseek(in, static_cast<off_t>(done), SEEK_SET) == -1
+           || lseek(out, static_cast<off_t>(done), SEEK_SET) == -1)
+            return false;
+#else
+        (void)size;
+#endif
+        std::vector<char> buf(128 * 1024);
+        while(true){
+            ssize_t n = read(in, buf.data(), buf.size());
+            if(n == 0)
+                return true;
+            if(n < 0){
+                if(errno == EINTR)
+                    continue;
+                return false;
+            }
+            for(ssize_t off = 0; off < n;){
+                ssize_t w = write(out, buf.data() + off, static_cast<size_t>(n - off));
+                if(w < 0){
+                    if(errno == EINTR)
+                        continue;
+                    return false;
+                }
+                off += w;
+            }
+        }
+    }
 }
 
 /**
     \brief Copy a file
+    \details The data is copied by the kernel where possible, see copyContents: a reflink on
+    filesystems that share blocks between files (btrfs, XFS) is close to free whatever the file's
+    size, otherwise copy_file_range or sendfile, with a plain read/write loop as the fallback
     @param curpath The current path to the file
     @param newpath Where to copy the file
-    @return True if file is successfully copied
+    @param preserve True to also copy the permission bits and the access/modification times,
+    otherwise newpath gets curpath's permissions less the umask and the current time
+    @return True if file is successfully copied, with preserve only if the permissions and times
+    were set too
+    @throws std::runtime_error if newpath already exists
 */
-bool FSUtils::copyf(const std::string &curpath, const std::string &newpath){
+bool FSUtils::copyf(const std::string &curpath, const std::string &newpath, bool preserve){
     if(!fexists(curpath) || !isFile(curpath))
         return false;
     if(fexists(newpath) || dexists(newpath))
         throw std::runtime_error(newpath + " already exists");
     
-    {
-        std::ifstream src(curpath, std::ios::binary);
-        std::ofstream dst(newpath, std::ios::binary);
-        dst << src.rdbuf();
+    int in = open(curpath.c_str(), O_RDONLY | O_CLOEXEC);
+    if(in == -1)
+        return false;
+    struct stat st;
+    if(fstat(in, &st) != 0){
+        close(in);
+        return false;
+    }
+    int out = open(newpath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, st.st_mode & 0777);
+    if(out == -1){
+        close(in);
+        return false;
+    }
+    
+    bool copied = copyContents(in, out, static_cast<size_t>(st.st_size));
+    if(copied && preserve){
+#ifdef __APPLE__
+        struct timespec times[2] = {st.st_atimespec, st.st_mtimespec};
+#else
+        struct timespec times[2] = {st.st_atim, st.st_mtim};
+#endif
+        copied = fchmod(out, st.st_mode & 07777) == 0 && futimens(out, times) == 0;
     }
+    close(in);
+    if(close(out) != 0)
+        copied = false;
+    // Don't leave half a file behind
+    if(!copied)
+        unlink(newpath.c_str());
+    
+    return copied;
+}
 
-    return fexists(curpath) && fexists(newpath);
+namespace{
+    // Copy a file, or a link as a link pointing at the same target
+    inline void copyEntry(const DirWalker::Entry &e, const std::string &newpath){
+        if(e.isFile()){
+            if(!FSUtils::copyf(std::string(e.path()), newpath))
+                throw std::runtime_error("Failed to copy " + std::string(e.path()));
+        }
+        else if(e.isSymlink()){
+            char target[PATH_MAX];
+            ssize_t len = readlinkat(e.dirFd(), e.name().data(), target, sizeof(target) - 1);
+            if(len < 0)
+                throw std::runtime_error("Couldn't read link " + std::string(e.path()));
+            target[len] = '\0';
+            if(symlink(target, newpath.c_str()) != 0)
+                throw std::runtime_error("Failed to create " + newpath);
+        }
+        else
+            throw std::runtime_error("Can't copy " + std::string(e.path())
+                                     + ", not a file, directory or link");
+    }
 }
 
 /**
     \brief Copy a directory
+    \details Symlinks inside the directory are copied as symlinks to the same target.
+    Subdirectories that can't be opened are created empty
     @param curpath The current path to the directory
     @param newpath Where to copy the directory
-    @return True if directory is successfully copied
-    @throws std::runtime_error if curpath can't be opened or newpath can't be created
+    @return True if directory is successfully copied, false if a subdirectory was skipped
+    @throws std::runtime_error if curpath can't be opened, or newpath or anything in it can't be
+    created
 */
 bool FSUtils::copyd(const std::string &curpath, const std::string &newpath){
     if(!dexists(curpath) || !isDir(curpath))
@@ -472,34 +815,285 @@ bool FSUtils::copyd(const std::string &curpath, const std::string &newpath){
     if(fexists(newpath) || dexists(newpath))
         throw std::runtime_error(newpath + " already exists");
     
-    DIR *dir;
-    struct dirent *ent;
-    
-    if((dir = opendir(curpath.c_str())) == NULL)
-        throw std::runtime_error("Couldn't open " + curpath);
+    DirWalker walk(curpath);
     
     // Step 1, create the directory at the new path
     if(!makeDir(newpath))
         throw std::runtime_error("Failed to create " + newpath);
     
-    while((ent = readdir(dir)) != NULL){
-        std::string it(ent->d_name);
-        // Don't want to do anything if we're on a dot
-        if(THIS_DIR_DOT == it || PREV_DIR_DOT == it)
-            continue;
-        std::string cur_item(curpath + "/" + it);
-        std::string new_item(newpath + "/" + it);
-        
-        if(isFile(cur_item))
-            copyf(cur_item, new_item);
-        // Make the recursive call
-        else if(isDir(cur_item))
-            copyd(cur_item, new_item);
+    std::string new_item(newpath + "/");
+    const size_t base = new_item.size();
+    for(auto &e : walk){
+        new_item.resize(base);
+        new_item += e.relative();
+        if(e.isDir()){
+            if(!makeDir(new_item))
+                throw std::runtime_error("Failed to create " + new_item);
+        }
         else
-            throw std::runtime_error("Is that a symlink?? Uh...not implemented!");
+            copyEntry(e, new_item);
+    }
+    return walk.errors() == 0 && dexists(newpath);
+}
+
+namespace{
+    // Runs a walk of a tree on a pool. Directories waiting to be listed go on a queue that at
+    // most max_open tasks drain, each holding one directory open at a time. For every directory
+    // enter(rel) runs before it's listed, leaf(entry, rel) for each non-directory in it (returning
+    // the bytes to count for it), and leave(rel) once it and everything below it are done. rel is
+    // the path below the root, "" for the root itself. A subdirectory that can't be opened is
+    // counted in skipped_ and left as it is, as DirWalker does
+    template <class Enter, class Leaf, class Leave>
+    class ParallelTree{
+    public:
+        ParallelTree(const std::string &root, ThreadPool &pool, const FSUtils::TreeProgressFn &progress,
+                     size_t max_open, Enter enter, Leaf leaf, Leave leave)
+            : root_(root)
+            , pool_(pool)
+            , progress_(progress)
+            , max_open_(std::max<size_t>(1, max_open))
+            , enter_(enter)
+            , leaf_(leaf)
+            , leave_(leave)
+            {}
+
+        // Walk everything below root, rethrows the first exception from any directory
+        FSUtils::TreeProgress run(){
+            schedule(std::make_shared<dir_t>("", nullptr));
+            std::unique_lock<std::mutex> lock(mutex_);
+            done_.wait(lock, [this]{ return running_ == 0; });
+            if(error_)
+                std::rethrow_exception(error_);
+            return totals_;
+        }
+
+    private:
+        struct dir_t{
+            dir_t(std::string rel, std::shared_ptr<dir_t> parent)
+                : rel_(std::move(rel))
+                , parent_(std::move(parent))
+                {}
+
+            std::string rel_;
+            std::shared_ptr<dir_t> parent_;
+            // Children still running, plus one for listing the directory itself
+            std::atomic<size_t> pending_{1};
+        };
+        using dir_ptr = std::shared_ptr<dir_t>;
+
+        std::string root_;
+        ThreadPool &pool_;
+        const FSUtils::TreeProgressFn &progress_;
+        size_t max_open_;
+        Enter enter_;
+        Leaf leaf_;
+        Leave leave_;
+
+        std::mutex mutex_;
+        std::condition_variable done_;
+        std::deque<dir_ptr> queue_;
+        size_t running_{0};
+        std::exception_ptr error_;
+        FSUtils::TreeProgress totals_;
+
+        void schedule(dir_ptr dir){
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                queue_.push_back(std::move(dir));
+                if(running_ >= max_open_)
+                    return;
+                ++running_;
+            }
+            try{
+                pool_.push([this]{ drain(); });
+            }
+            catch(...){
+                std::lock_guard<std::mutex> lock(mutex_);
+                if(!error_)
+                    error_ = std::current_exception();
+                if(--running_ == 0)
+                    done_.notify_all();
+            }
+        }
+
+        void drain(){
+            while(true){
+                dir_ptr dir;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if(queue_.empty() || error_){
+                        if(--running_ == 0)
+                            done_.notify_all();
+                        return;
+                    }
+                    dir = std::move(queue_.front());
+                    queue_.pop_front();
+                }
+                try{
+                    list(dir);
+                }
+                catch(...){
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if(!error_)
+                        error_ = std::current_exception();
+                }
+            }
+        }
+
+        // The first entry of walk, or its end if the directory can't be opened. Only the root throws
+        static DirWalker::iterator open(DirWalker &walk, bool root, bool &skipped){
+            try{
+                return walk.begin();
+            }
+            catch(std::runtime_error &){
+                if(root)
+                    throw;
+                skipped = true;
+                return walk.end();
+            }
+        }
+
+        void list(const dir_ptr &dir){
+            enter_(dir->rel_);
+            size_t files = 0, bytes = 0;
+            bool skipped = false;
+            {
+                DirWalker walk(dir->rel_.empty() ? root_ : root_ + "/" + dir->rel_);
+                walk.maxDepth(0);
+                for(auto it = open(walk, dir->rel_.empty(), skipped); it != walk.end(); ++it){
+                    auto &e = *it;
+                    if(e.isDir()){
+                        ++dir->pending_;
+                        std::string rel = dir->rel_.empty() ? std::string(e.name())
+                                                            : dir->rel_ + "/" + std::string(e.name());
+                        schedule(std::make_shared<dir_t>(std::move(rel), dir));
+                    }
+                    else{
+                        bytes += leaf_(e, dir->rel_);
+                        ++files;
+                    }
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ++totals_.dirs_;
+                totals_.skipped_ += skipped;
+                totals_.files_ += files;
+                totals_.bytes_ += bytes;
+                if(progress_)
+                    progress_(totals_);
+            }
+            // The last one out of each directory finishes it and moves up to its parent
+            for(dir_t *d = dir.get(); d && --d->pending_ == 0; d = d->parent_.get())
+                leave_(d->rel_);
+        }
+    };
+
+    template <class Enter, class Leaf, class Leave>
+    FSUtils::TreeProgress walkParallel(const std::string &root, ThreadPool &pool,
+                                       const FSUtils::TreeProgressFn &progress, size_t max_open,
+                                       Enter enter, Leaf leaf, Leave leave){
+        ParallelTree<Enter, Leaf, Leave> tree(root, pool, progress, max_open, enter, leaf, leave);
+        return tree.run();
     }
-    closedir(dir);
-    return dexists(newpath);
+}
+
+/**
+    \brief Count the directories, files and bytes below a directory, listing directories in parallel
+    \details Subdirectories are spread across pool through a work queue, with at most max_open
+    directories open at once. progress is called after each directory is listed, one call at a
+    time, from the pool's threads. Symlinks are counted as files, not followed. Subdirectories
+    that can't be opened are counted in skipped_ and not descended into. Don't call this from a
+    task running on the same pool
+    @param dirpath The path to the directory
+    @param pool Pool to list directories on
+    @param progress Optional callback with the totals so far
+    @param max_open Most directories open at once
+    @return The totals, dirpath itself is counted as a directory
+    @throws std::runtime_error if dirpath can't be opened
+*/
+FSUtils::TreeProgress FSUtils::scanDir(const std::string &dirpath, ThreadPool &pool,
+                                       const TreeProgressFn &progress, size_t max_open){
+    return walkParallel(dirpath, pool, progress, max_open,
+                        [](const std::string &){},
+                        [](const DirWalker::Entry &e, const std::string &) -> size_t {
+                            struct stat st;
+                            if(fstatat(e.dirFd(), e.name().data(), &st, AT_SYMLINK_NOFOLLOW) != 0)
+                                return 0;
+                            return static_cast<size_t>(st.st_size);
+                        },
+                        [](const std::string &){});
+}
+
+/**
+    \brief Delete a directory and contents, deleting subdirectories in parallel
+    \details As deleteDir(dirpath), with subdirectories spread across pool through a work queue and
+    at most max_open directories open at once. Each directory is removed once everything in it
+    is. progress is called after each directory is emptied of files, one call at a time, from the
+    pool's threads. Subdirectories that can't be opened are skipped and counted in skipped_, so
+    they and dirpath are left behind. Don't call this from a task running on the same pool
+    @param dirpath The path to the directory
+    @param pool Pool to delete on
+    @param progress Optional callback with the totals so far
+    @param max_open Most directories open at once
+    @return True if the directory does not exist at the end of the function
+    @throws std::runtime_error if dirpath can't be opened
+*/
+bool FSUtils::deleteDir(const std::string &dirpath, ThreadPool &pool, const TreeProgressFn &progress,
+                        size_t max_open){
+    if(!dexists(dirpath))
+        return true;
+
+    walkParallel(dirpath, pool, progress, max_open,
+                 [](const std::string &){},
+                 [](const DirWalker::Entry &e, const std::string &) -> size_t {
+                     unlinkat(e.dirFd(), e.name().data(), 0);
+                     return 0;
+                 },
+                 [&dirpath](const std::string &rel){
+                     rmdir((rel.empty() ? dirpath : dirpath + "/" + rel).c_str());
+                 });
+
+    return !dexists(dirpath);
+}
+
+/**
+    \brief Copy a directory, copying subdirectories in parallel
+    \details As copyd(curpath, newpath), with subdirectories spread across pool through a work queue
+    and at most max_open directories open at once. progress is called after each directory's files
+    are copied, one call at a time, from the pool's threads. Subdirectories that can't be opened are
+    created empty and counted in skipped_. Don't call this from a task running on the same pool
+    @param curpath The current path to the directory
+    @param newpath Where to copy the directory
+    @param pool Pool to copy on
+    @param progress Optional callback with the totals so far
+    @param max_open Most directories open at once
+    @return True if directory is successfully copied, false if a subdirectory was skipped
+    @throws std::runtime_error if curpath can't be opened, or newpath or anything in it can't be
+    created
+*/
+bool FSUtils::copyd(const std::string &curpath, const std::string &newpath, ThreadPool &pool,
+                    const TreeProgressFn &progress, size_t max_open){
+    if(!dexists(curpath) || !isDir(curpath))
+        return false;
+    if(fexists(newpath) || dexists(newpath))
+        throw std::runtime_error(newpath + " already exists");
+
+    auto target = [&newpath](const std::string &rel){
+        return rel.empty() ? newpath : newpath + "/" + rel;
+    };
+    auto totals = walkParallel(curpath, pool, progress, max_open,
+                               [&target](const std::string &rel){
+                                   std::string dir = target(rel);
+                                   if(!makeDir(dir))
+                                       throw std::runtime_error("Failed to create " + dir);
+                               },
+                               [&target](const DirWalker::Entry &e, const std::string &rel) -> size_t {
+                                   copyEntry(e, target(rel) + "/" + std::string(e.name()));
+                                   return 0;
+                               },
+                               [](const std::string &){});
+    return totals.skipped_ == 0 && dexists(newpath);
 }
 
 /**
@@ -540,16 +1134,32 @@ float FSUtils::fsize(const std::string &filepath, const std::string &order){
 
 /**
     \brief Parse a csv file into a 2D vector
-    \details The function parses a csv, reading the file line by line then splitting each line on 
-    the commas, returning a 2D vector representing the rows/cols of the csv...i.e. a matrix.
+    \details The function parses a csv with CSVReader (RFC 4180, quoted fields are handled),
+    returning a 2D vector representing the rows/cols of the csv...i.e. a matrix. Every field is
+    copied into its own string, use CSVReader directly for large files. Rows keep the shape they
+    had when lines were split on commas: blank lines are empty rows and an empty last field is
+    dropped ("1,2," is 2 fields, "1,2,," is 3)
     @param fileName File name if file is in cwd, else path to file
     @return A vector<vector<string>> that represents rows/column of the csv file
+    @throws std::runtime_error if fileName can't be opened
 */
 std::vector<std::vector<std::string>> FSUtils::csvToMatrix(const std::string& fileName){
-    auto file_lines = readLineByLine(fileName);
     std::vector<std::vector<std::string>> matrix;
-    for(auto &&line : file_lines)
-        matrix.emplace_back(StrUtils::parseOnCharDelim(StrUtils::trim(line), ','));
+    CSVReader csv(fileName);
+    csv.skipBlankLines(false);
+    while(csv.next()){
+        std::vector<std::string> row(csv.row().begin(), csv.row().end());
+        if(!row.empty()){
+            // Leading / trailing spaces of the line are trimmed, as they always have been
+            row.front().erase(0, row.front().find_first_not_of(' '));
+            row.back().erase(row.back().find_last_not_of(' ') + 1);
+            // Splitting a line on commas never gave an empty last field, so "1,2," is 2 fields and a
+            // line of spaces is an empty row
+            if(row.back().empty())
+                row.pop_back();
+        }
+        matrix.push_back(std::move(row));
+    }
     return matrix;
 }
 
@@ -583,20 +1193,112 @@ std::string FSUtils::getWorkingDir(){
 }
 
 
+namespace{
+    inline FSUtils::FileInfo::Type fileType(uint32_t mode){
+        if(S_ISREG(mode))
+            return FSUtils::FileInfo::FILE;
+        if(S_ISDIR(mode))
+            return FSUtils::FileInfo::DIR;
+        if(S_ISLNK(mode))
+            return FSUtils::FileInfo::SYMLINK;
+        return FSUtils::FileInfo::OTHER;
+    }
+    
+#if defined(__linux__)
+    inline FSUtils::FileInfo fromStatx(const struct statx &stx){
+        FSUtils::FileInfo info;
+        info.type_ = fileType(stx.stx_mode);
+        info.size_ = stx.stx_size;
+        info.mode_ = stx.stx_mode;
+        info.inode_ = stx.stx_ino;
+        info.dev_ = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+        info.mtime_ = {stx.stx_mtime.tv_sec, stx.stx_mtime.tv_nsec};
+        info.atime_ = {stx.stx_atime.tv_sec, stx.stx_atime.tv_nsec};
+        info.ctime_ = {stx.stx_ctime.tv_sec, stx.stx_ctime.tv_nsec};
+        return info;
+    }
+#else
+    inline FSUtils::FileInfo fromStat(const struct stat &st){
+        FSUtils::FileInfo info;
+        info.type_ = fileType(st.st_mode);
+        info.size_ = static_cast<uint64_t>(st.st_size);
+        info.mode_ = st.st_mode;
+        info.inode_ = st.st_ino;
+        info.dev_ = st.st_dev;
+    #ifdef __APPLE__
+        info.mtime_ = st.st_mtimespec;
+        info.atime_ = st.st_atimespec;
+        info.ctime_ = st.st_ctimespec;
+    #else
+        info.mtime_ = st.st_mtim;
+        info.atime_ = st.st_atim;
+        info.ctime_ = st.st_ctim;
+    #endif
+        return info;
+    }
+#endif
+    
+    // Same format as asctime without the newline, but thread safe
+    inline std::string formatTime(const struct timespec &ts){
+        struct tm timeinfo;
+        localtime_r(&ts.tv_sec, &timeinfo);
+        char buf[64];
+        size_t len = strftime(buf, sizeof(buf), "%a %b %e %H:%M:%S %Y", &timeinfo);
+        return std::string(buf, len);
+    }
+}
+
+/**
+    \brief Type, size, permissions, inode, and times of a path from a single statx call
+    \details Nothing is formatted, the times are left as timespecs, so checking whether a file
+    changed is one syscall and a few integer compares
+    @param path Path to a file, directory, or anything else
+    @param follow False to describe a symlink itself rather than what it points to
+    @return The info, type_ is FileInfo::NONE if path doesn't exist or can't be stat'ed
+*/
+FSUtils::FileInfo FSUtils::fileInfo(const std::string &path, bool follow){
+#if defined(__linux__)
+    struct statx stx;
+    int flags = follow ? 0 : AT_SYMLINK_NOFOLLOW;
+    if(statx(AT_FDCWD, path.c_str(), flags, STATX_BASIC_STATS, &stx) != 0)
+        return FileInfo();
+    return fromStatx(stx);
+#else
+    struct stat st;
+    if((follow ? ::stat(path.c_str(), &st) : lstat(path.c_str(), &st)) != 0)
+        return FileInfo();
+    return fromStat(st);
+#endif
+}
+
+/**
+    \brief fileInfo for many paths
+    \details AsyncIO.hpp adds an overload that batches the statx calls through io_uring
+    @param paths Paths to look up
+    @param follow False to describe symlinks themselves rather than what they point to
+    @return One FileInfo per path, in the same order
+*/
+std::vector<FSUtils::FileInfo> FSUtils::fileInfo(const std::vector<std::string> &paths, bool follow){
+    std::vector<FileInfo> infos;
+    infos.reserve(paths.size());
+    for(auto &p : paths)
+        infos.push_back(fileInfo(p, follow));
+    return infos;
+}
+
 /**
     \brief Return the permissions (user group global) of specified file or directory
     @return A string representing the 3 digit permissions
     @throws std::runtime_error if path can't be found
 */
 std::string FSUtils::getPermissions(const std::string &path){
-    if(!dexists(path) && !fexists(path))
+    FileInfo info = fileInfo(path);
+    if(!info.exists())
         throw std::runtime_error("Can't find " + path);
     
-    struct stat buffer;
-    stat(path.c_str(), &buffer);
-    auto user = (buffer.st_mode & S_IRWXU) >> 6;
-    auto group = (buffer.st_mode & S_IRWXG) >> 3;
-    auto world = (buffer.st_mode & S_IRWXO);
+    auto user = (info.mode_ & S_IRWXU) >> 6;
+    auto group = (info.mode_ & S_IRWXG) >> 3;
+    auto world = (info.mode_ & S_IRWXO);
     
     auto perms = std::to_string(user) + std::to_string(group) + std::to_string(world);
     return perms;
@@ -604,34 +1306,28 @@ std::string FSUtils::getPermissions(const std::string &path){
 
 /**
     \brief Return the last modified time of a file or directory
+    \details For comparing times use fileInfo(path).mtime_, this builds a string
     \return A time string
     @throws std::runtime_error if path can't be found
 */
 std::string FSUtils::getModifiedTime(const std::string &path){
-    if(!dexists(path) && !fexists(path))
+    FileInfo info = fileInfo(path);
+    if(!info.exists())
         throw std::runtime_error("Can't find " + path);
-    
-    struct stat buffer;
-    stat(path.c_str(), &buffer);
-    struct tm *timeinfo = localtime(&buffer.st_mtime);
-    std::string remove_newline(asctime(timeinfo));
-    return remove_newline.substr(0, remove_newline.length() - 1);
+    return formatTime(info.mtime_);
 }
 
 /**
     \brief Return the last access time of a file or directory
+    \details For comparing times use fileInfo(path).atime_, this builds a string
     \return A time string
     @throws std::runtime_error if path can't be found
 */
 std::string FSUtils::getAccessTime(const std::string &path){
-    if(!dexists(path) && !fexists(path))
+    FileInfo info = fileInfo(path);
+    if(!info.exists())
         throw std::runtime_error("Can't find " + path);
-    
-    struct stat buffer;
-    stat(path.c_str(), &buffer);
-    struct tm *timeinfo = localtime(&buffer.st_atime);
-    std::string remove_newline(asctime(timeinfo));
-    return remove_newline.substr(0, remove_newline.length() - 1);
+    return formatTime(info.atime_);
 }
 
 /**
@@ -0,0 +1,220 @@
+//
+//  FileCache.hpp
+//  cppcommon
+//
+
+#pragma once
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <algorithm>
+#include "FileHandle.hpp"
+
+/**
+    \brief Thread safe cache of file contents, shared by everyone reading the same path
+    \details Each path is loaded once into an immutable FileHandle::Contents that every caller gets
+    a pointer to, instead of each thread or FileHandle holding its own copy. Every get checks the
+    file the way FileHandle does (one stat in STAT mode, nothing in NOTIFY mode) and reloads it if
+    it changed; snapshots handed out before stay valid. Different paths load in parallel, callers
+    asking for the same path wait for one load.\n
+    The least recently used paths are dropped once the cache holds more than max_bytes of contents
+    or max_entries paths. Contents still held by callers stay alive and aren't counted. Usually
+    used through the process wide instance(), e.g. \n
+    auto table = FileCache::instance().get("lookup.csv"); \n
+    for(std::string_view line : table->lines()) \n
+        ...
+    \date 10-18-26
+*/
+class FileCache{
+public:
+    using Contents = FileHandle::Contents;
+
+    static constexpr size_t DEFAULT_MAX_BYTES{256 * 1024 * 1024};
+    static constexpr size_t DEFAULT_MAX_ENTRIES{4096};
+
+    struct Stats{
+        // Gets answered from the cache, unchanged
+        size_t hits_{0};
+        // Gets that loaded or reloaded the file
+        size_t loads_{0};
+        // Paths dropped to stay under the limits
+        size_t evictions_{0};
+    };
+
+    /**
+        \brief The cache shared by the whole process, with the default limits in STAT mode
+    */
+    static FileCache &instance(){
+        static FileCache cache;
+        return cache;
+    }
+
+    /**
+        \brief A separate cache
+        @param max_bytes Most bytes of contents to hold
+        @param max_entries Most paths to hold
+        @param freshness How cached files are checked for changes, see FileHandle
+    */
+    explicit FileCache(size_t max_bytes = DEFAULT_MAX_BYTES, size_t max_entries = DEFAULT_MAX_ENTRIES,
+                       FileHandle::Freshness freshness = FileHandle::Freshness::STAT)
+        : max_bytes_(max_bytes)
+        , max_entries_(std::max<size_t>(1, max_entries))
+        , freshness_(freshness)
+        {}
+
+    FileCache(const FileCache&) = delete;
+    FileCache &operator=(const FileCache&) = delete;
+
+    /**
+        \brief Contents of a file, loaded or reloaded if needed
+        @param path The file to read
+        @return The contents as of this call, valid for as long as it's held
+        @throws std::runtime_error if path isn't a file or can't be read
+    */
+    std::shared_ptr<const Contents> get(const std::string &path){
+        std::shared_ptr<entry_t> entry;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto found = entries_.find(path);
+            if(found != entries_.end()){
+                entry = found->second;
+                lru_.splice(lru_.begin(), lru_, entry->lru_pos_);
+            }
+        }
+        // Checked outside the lock, FileHandle would create a missing file
+        if(!entry){
+            if(!FSUtils::fileInfo(path).isFile())
+                throw std::runtime_error("Couldn't open " + path);
+            entry = insert(path);
+        }
+
+        std::shared_ptr<const Contents> contents;
+        bool loaded;
+        {
+            std::lock_guard<std::mutex> lock(entry->mutex_);
+            contents = entry->handle_.contents();
+            loaded = contents != entry->last_;
+            entry->last_ = contents;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(!loaded){
+            ++stats_.hits_;
+            return contents;
+        }
+        ++stats_.loads_;
+        // Dropped while it loaded, it's not counted any more
+        auto found = entries_.find(path);
+        if(found == entries_.end() || found->second != entry)
+            return contents;
+        bytes_ = bytes_ - entry->bytes_ + contents->text().size();
+        entry->bytes_ = contents->text().size();
+        evict();
+        return contents;
+    }
+
+    /**
+        \brief Drop a path, the next get reloads it
+        @return False if it wasn't cached
+    */
+    bool invalidate(const std::string &path){
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = entries_.find(path);
+        if(found == entries_.end())
+            return false;
+        erase(found);
+        return true;
+    }
+
+    /**
+        \brief Drop every path
+    */
+    void clear(){
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.clear();
+        lru_.clear();
+        bytes_ = 0;
+    }
+
+    /**
+        \brief Number of paths cached
+    */
+    size_t size(){
+        std::lock_guard<std::mutex> lock(mutex_);
+        return entries_.size();
+    }
+
+    /**
+        \brief Bytes of contents cached
+    */
+    size_t bytes(){
+        std::lock_guard<std::mutex> lock(mutex_);
+        return bytes_;
+    }
+
+    Stats stats(){
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+private:
+    struct entry_t{
+        entry_t(const std::string &path, FileHandle::Freshness freshness)
+            : handle_(path, false, freshness)
+            {}
+
+        // Held while the handle checks or loads, so one path loads once
+        std::mutex mutex_;
+        FileHandle handle_;
+        // What handle_ gave last time, a different pointer means it reloaded
+        std::shared_ptr<const Contents> last_;
+        // Under the cache's mutex_
+        size_t bytes_{0};
+        std::list<std::string>::iterator lru_pos_;
+    };
+    using map_t = std::unordered_map<std::string, std::shared_ptr<entry_t>>;
+
+    size_t max_bytes_;
+    size_t max_entries_;
+    FileHandle::Freshness freshness_;
+    std::mutex mutex_;
+    map_t entries_;
+    // Most recently used first
+    std::list<std::string> lru_;
+    size_t bytes_{0};
+    Stats stats_;
+
+    // The handle is made outside the lock since NOTIFY mode sets up a watch
+    std::shared_ptr<entry_t> insert(const std::string &path){
+        auto made = std::make_shared<entry_t>(path, freshness_);
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto inserted = entries_.emplace(path, made);
+        // Someone else got there first
+        if(!inserted.second){
+            lru_.splice(lru_.begin(), lru_, inserted.first->second->lru_pos_);
+            return inserted.first->second;
+        }
+        lru_.push_front(path);
+        made->lru_pos_ = lru_.begin();
+        return made;
+    }
+
+    // Under mutex_
+    void erase(map_t::iterator it){
+        bytes_ -= it->second->bytes_;
+        lru_.erase(it->second->lru_pos_);
+        entries_.erase(it);
+    }
+
+    // Under mutex_, never drops the most recent path
+    void evict(){
+        while(entries_.size() > 1 && (bytes_ > max_bytes_ || entries_.size() > max_entries_)){
+            erase(entries_.find(lru_.back()));
+            ++stats_.evictions_;
+        }
+    }
+};
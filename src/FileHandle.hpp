@@ -8,41 +8,173 @@
 
 #pragma once
 
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
 #include "FSUtils.hpp"
 
+#if defined(__linux__)
+    #include "FileWatcher.hpp"
+#endif
+
 /**
     \brief Basic FileHandle class to ease interactions with files
-    \details Content of file is loaded lazily, i.e. not until content is requested. Content will 
- automatically be reloaded if the file has been modified between calls for the content. 
+    \details Content of file is loaded lazily, i.e. not until content is requested. Content will
+ automatically be reloaded if the file has been modified between calls for the content. In STAT
+ mode each read costs one stat call, comparing inode, size and the nanosecond mtime with what was
+ loaded. In NOTIFY mode the file is watched through a shared FileWatcher and cached reads make no
+ syscalls at all, a change is picked up once its notification arrives (usually well under a
+ millisecond later).\n
+ contents() hands out immutable snapshots that stay valid however often the file is reloaded
+ afterwards, text() and lines() are references into the current one for callers that don't keep
+ them across reads. Nothing is copied on a cached read through any of these
     \author Sean Grimes, spg63@cs.drexel.edu
     \date 04-14-17
 */
 class FileHandle{
+public:
+    // How a FileHandle notices the file changed
+    enum class Freshness{
+        STAT,
+        NOTIFY
+    };
+
+    /**
+        \brief One load of the file, never changed once made so it can be shared between threads
+    */
+    class Contents{
+    public:
+        explicit Contents(std::string text) : text_(std::move(text)) {}
+
+        const std::string &text() const { return text_; }
+
+        /**
+            \brief Views of the lines of text(), split as LineRange does
+            \details Built on first use, once, thread safe
+        */
+        const std::vector<std::string_view> &lines() const {
+            std::call_once(lines_once_, [this]{
+                for(std::string_view line : LineRange(std::string_view(text_)))
+                    lines_.push_back(line);
+                lines_.shrink_to_fit();
+            });
+            return lines_;
+        }
+
+    private:
+        std::string text_;
+        mutable std::once_flag lines_once_;
+        mutable std::vector<std::string_view> lines_;
+    };
+
 private:
-    std::vector<std::string> content_vec_;
-    std::string content_str_    {""};
+    // What a cache was loaded from
+    struct version_t{
+        bool loaded_{false};
+        FSUtils::FileInfo info_;
+        uint64_t notified_{0};
+
+        bool sameAs(const version_t &other) const {
+            return loaded_ && other.loaded_ && notified_ == other.notified_
+                && info_.sameVersion(other.info_);
+        }
+    };
+
+    std::shared_ptr<const Contents> contents_;
     std::vector<char> binary_vec_;
     std::string path_           {""};
     size_t raw_size_            {0};
     size_t line_count_          {0};
     std::string permissions_    {""};
-    std::string last_access_    {""};
-    std::string last_modified_  {""};
     // 0 for file, 1 for dir
     short file_or_dir_          {-1};
+    Freshness freshness_        {Freshness::STAT};
+    version_t version_;
+
+#if defined(__linux__)
+    // Bumped by the watcher, shared by copies of the handle, the watch ends with the last of them
+    struct notify_t{
+        std::atomic<uint64_t> version_{0};
+        // False once the watch has ended, versions stop moving
+        std::atomic<bool> live_{true};
+        int id_{-1};
+
+        ~notify_t(){
+            if(id_ >= 0)
+                watcher()->unwatch(id_);
+        }
+    };
+    std::shared_ptr<notify_t> notify_;
 
-    bool hasBeenModified(){
-        auto modded = FSUtils::getModifiedTime(path_);
-        if(last_modified_ == modded)
+    // Shared by every handle in NOTIFY mode, nullptr if inotify isn't available. Never destroyed
+    // so it outlives static handles. Callbacks only bump a counter, so they run on its thread
+    static FileWatcher *watcher(){
+        static FileWatcher *shared = []() -> FileWatcher* {
+            try{
+                return new FileWatcher(std::chrono::milliseconds(0));
+            }
+            catch(const std::runtime_error &){
+                return nullptr;
+            }
+        }();
+        return shared;
+    }
+
+    bool startWatching(){
+        auto *w = watcher();
+        if(!w)
             return false;
-        last_modified_ = modded;
+        auto notify = std::make_shared<notify_t>();
+        std::weak_ptr<notify_t> weak = notify;
+        try{
+            notify->id_ = w->watch(path_, [weak](const FileWatcher::Event &ev){
+                if(auto n = weak.lock()){
+                    if(ev.has(FileWatcher::UNWATCHED))
+                        n->live_.store(false, std::memory_order_release);
+                    n->version_.fetch_add(1, std::memory_order_release);
+                }
+            });
+        }
+        catch(const std::runtime_error &){
+            return false;
+        }
+        notify_ = std::move(notify);
         return true;
     }
+#else
+    bool startWatching(){ return false; }
+#endif
+
+    // Taken before reading, so a change during the read is seen by the next call
+    version_t currentVersion() const {
+        version_t v;
+        v.loaded_ = true;
+#if defined(__linux__)
+        if(notify_ && notify_->live_.load(std::memory_order_acquire)){
+            v.notified_ = notify_->version_.load(std::memory_order_acquire);
+            return v;
+        }
+#endif
+        v.info_ = FSUtils::fileInfo(path_);
+        return v;
+    }
 
 
 public:
     FileHandle(const std::string &path) : FileHandle(path, false) {}
-    FileHandle(const std::string &path, bool overwrite_if_existing) : path_(path) {
+    /**
+        \brief Open a file, creating it if it doesn't exist
+        @param path The path to the file
+        @param overwrite_if_existing Empty the file if it already exists
+        @param freshness How to notice changes, NOTIFY falls back to STAT if the file can't be watched
+    */
+    FileHandle(const std::string &path, bool overwrite_if_existing, Freshness freshness = Freshness::STAT)
+        : path_(path) {
         /*
         if(FSUtils::isFile(path_))
             file_or_dir_ = 0;
@@ -68,43 +200,71 @@ public:
             std::ofstream out(path_);
             out << "";
         }
-        
-        last_access_ = FSUtils::getAccessTime(path_);
-        last_modified_ = FSUtils::getModifiedTime(path_);
+
+        if(freshness == Freshness::NOTIFY && startWatching())
+            freshness_ = Freshness::NOTIFY;
     }
-    
+
+    /**
+        \brief How changes to the file are noticed
+        @return NOTIFY only if it was asked for and the file could be watched
+    */
+    Freshness freshness() const { return freshness_; }
+
+    /**
+        \brief Snapshot of the file, reloaded first if it changed
+        \details The snapshot stays valid, and unchanged, after later reloads. Cached reads only
+        copy the pointer
+        @return The contents as of this call
+        @throws std::runtime_error if the file can't be read
+    */
+    std::shared_ptr<const Contents> contents(){
+        auto now = currentVersion();
+        if(!version_.sameAs(now)){
+            contents_ = std::make_shared<const Contents>(FSUtils::readFullFile(path_));
+            version_ = now;
+        }
+        return contents_;
+    }
+
+    /**
+        \brief The whole file, without copying it
+        @return Reference valid until the next call on this handle that reloads
+        @throws std::runtime_error if the file can't be read
+    */
+    const std::string &text(){
+        contents();
+        return contents_->text();
+    }
+
+    /**
+        \brief Views of each line of the file, without copying them
+        \details The index is built once per load, see Contents::lines
+        @return Reference valid until the next call on this handle that reloads
+        @throws std::runtime_error if the file can't be read
+    */
+    const std::vector<std::string_view> &lines(){
+        contents();
+        return contents_->lines();
+    }
+
     /**
         \brief Read a complete file as a single string
+        \details Copies the whole file every call, text() or contents() don't
         @return A string representing the entire file
     */
     std::string readAsString(){
-        if(content_str_ == "" || hasBeenModified())
-            content_str_ = FSUtils::readFullFile(path_);
-        return content_str_;
+        return text();
     }
-    
+
     /**
         \brief Read file into vector<string> of lines
+        \details Copies every line every call, lines() doesn't
         @return A vector of strings, each string representing a line of the file
     */
     std::vector<std::string> readAsVector(){
-        if(content_vec_.size() == 0 || hasBeenModified())
-            content_vec_ = FSUtils::readLineByLine(path_);
-        return content_vec_;
+        auto &views = lines();
+        return std::vector<std::string>(views.begin(), views.end());
     }
-    
-};
-
-
-
-
-
-
-
-
-
-
-
-
-
 
+};
@@ -0,0 +1,426 @@
+//
+//  FileWatcher.hpp
+//  cppcommon
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include "ThreadPool.hpp"
+#include "DirWalker.hpp"
+
+/**
+    \brief Watch files and directories for changes through inotify
+    \details One thread blocks in poll on an inotify fd, so nothing is polled and changes are seen
+    as soon as the kernel reports them. Events for the same path on the same watch that arrive
+    within the coalescing window of the first are merged into one Event, with every kind seen
+    OR'd together, so a burst of writes to a file is one callback. Callbacks go to a ThreadPool,
+    or run on the watcher's thread if no pool is given (keep those short, they hold up every other
+    watch). Callbacks for one watch can run concurrently on a pool.\n
+    A file is watched through its directory, filtered to its name, so it can be created later and
+    a replace by rename is seen as MOVED_IN. A directory reports events for its own entries, a
+    recursive watch adds directories created or moved in below it as they appear. Linux only.
+    \date 10-18-26
+*/
+class FileWatcher{
+public:
+    enum Kind : uint32_t{
+        MODIFIED    = 1 << 0,
+        ATTRIB      = 1 << 1,
+        CREATED     = 1 << 2,
+        DELETED     = 1 << 3,
+        MOVED_IN    = 1 << 4,
+        MOVED_OUT   = 1 << 5,
+        // The kernel queue overflowed and events were lost, path is the watched path
+        OVERFLOW    = 1 << 6,
+        // The watched path (or a file's directory) went away, nothing more will be reported
+        UNWATCHED   = 1 << 7
+    };
+
+    /**
+        \brief What happened to one path, possibly several events merged
+    */
+    struct Event{
+        std::string path_;
+        // Kind bits
+        uint32_t kinds_{0};
+        bool has(Kind k) const { return (kinds_ & k) != 0; }
+    };
+
+    using Callback = std::function<void(const Event&)>;
+
+    /**
+        \brief Start a watcher that runs callbacks on pool
+        @param pool Pool to run callbacks on, must outlive the watcher
+        @param coalesce Window to merge events for the same path in
+        @throws std::runtime_error if inotify can't be set up
+    */
+    explicit FileWatcher(ThreadPool &pool, std::chrono::milliseconds coalesce = std::chrono::milliseconds(20))
+        : FileWatcher(&pool, coalesce) {}
+
+    /**
+        \brief Start a watcher that runs callbacks on its own thread
+        @param coalesce Window to merge events for the same path in
+        @throws std::runtime_error if inotify can't be set up
+    */
+    explicit FileWatcher(std::chrono::milliseconds coalesce = std::chrono::milliseconds(20))
+        : FileWatcher(nullptr, coalesce) {}
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher &operator=(const FileWatcher&) = delete;
+
+    /**
+        \brief Stops the watcher's thread, events not yet delivered are dropped
+    */
+    ~FileWatcher(){
+        uint64_t one = 1;
+        ssize_t wrote = ::write(stop_fd_, &one, sizeof(one));
+        (void)wrote;
+        thread_.join();
+        ::close(fd_);
+        ::close(stop_fd_);
+    }
+
+    /**
+        \brief Watch a file or directory
+        \details A path that doesn't exist is watched as a file, its directory has to exist
+        @param path The file or directory to watch
+        @param callback Called with each (coalesced) event
+        @param recursive Also watch every directory below a watched directory
+        @return An id for unwatch
+        @throws std::runtime_error if the path (or a file's directory) can't be watched
+    */
+    int watch(const std::string &path, Callback callback, bool recursive = false){
+        std::string clean = path;
+        while(clean.size() > 1 && clean.back() == '/')
+            clean.pop_back();
+
+        struct stat st;
+        bool is_dir = ::stat(clean.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+        std::lock_guard<std::mutex> lock(mutex_);
+        int id = next_id_++;
+        auto &sub = subs_[id];
+        sub.path_ = clean;
+        sub.recursive_ = recursive && is_dir;
+        sub.callback_ = std::make_shared<Callback>(std::move(callback));
+
+        bool added;
+        if(is_dir){
+            added = addWatch(id, clean);
+            if(added && sub.recursive_)
+                addTree(id, clean);
+        }
+        else{
+            auto slash = clean.find_last_of('/');
+            sub.name_ = slash == std::string::npos ? clean : clean.substr(slash + 1);
+            added = addWatch(id, slash == std::string::npos ? "." : (slash == 0 ? "/" : clean.substr(0, slash)));
+        }
+        if(!added){
+            subs_.erase(id);
+            throw std::runtime_error("Couldn't watch " + path);
+        }
+        return id;
+    }
+
+    /**
+        \brief Stop a watch
+        \details A callback that's already been handed to the pool can still run after this returns
+        @param id What watch returned
+        @return False if there's no such watch
+    */
+    bool unwatch(int id){
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto sub = subs_.find(id);
+        if(sub == subs_.end())
+            return false;
+        for(int wd : sub->second.wds_)
+            dropWatch(wd, id);
+        for(auto it = pending_.begin(); it != pending_.end();){
+            if(it->first.first == id)
+                it = pending_.erase(it);
+            else
+                ++it;
+        }
+        subs_.erase(sub);
+        return true;
+    }
+
+    /**
+        \brief Number of active watches
+    */
+    size_t size(){
+        std::lock_guard<std::mutex> lock(mutex_);
+        return subs_.size();
+    }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    static constexpr uint32_t MASK = IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE
+        | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+    struct sub_t{
+        std::string path_;
+        // Set for file watches, the name to pick out of the directory's events
+        std::string name_;
+        bool recursive_{false};
+        std::shared_ptr<Callback> callback_;
+        std::vector<int> wds_;
+    };
+
+    // One inotify watch, shared by every sub watching that directory
+    struct wd_t{
+        std::string path_;
+        std::vector<int> subs_;
+    };
+
+    struct pending_t{
+        uint32_t kinds_{0};
+        clock::time_point due_;
+    };
+
+    ThreadPool *pool_;
+    std::chrono::milliseconds coalesce_;
+    int fd_{-1};
+    int stop_fd_{-1};
+    std::mutex mutex_;
+    int next_id_{0};
+    std::unordered_map<int, sub_t> subs_;
+    std::unordered_map<int, wd_t> wds_;
+    // (sub id, path) -> kinds seen so far
+    std::map<std::pair<int, std::string>, pending_t> pending_;
+    std::thread thread_;
+
+    FileWatcher(ThreadPool *pool, std::chrono::milliseconds coalesce)
+        : pool_(pool)
+        , coalesce_(coalesce)
+    {
+        fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if(fd_ < 0)
+            throw std::runtime_error("Couldn't start inotify: " + std::string(strerror(errno)));
+        stop_fd_ = eventfd(0, EFD_CLOEXEC);
+        if(stop_fd_ < 0){
+            ::close(fd_);
+            throw std::runtime_error("Couldn't create eventfd: " + std::string(strerror(errno)));
+        }
+        thread_ = std::thread([this]{ run(); });
+    }
+
+    // Under mutex_
+    bool addWatch(int id, const std::string &dir){
+        int wd = inotify_add_watch(fd_, dir.c_str(), MASK);
+        if(wd < 0)
+            return false;
+        auto &w = wds_[wd];
+        if(w.path_.empty())
+            w.path_ = dir;
+        if(std::find(w.subs_.begin(), w.subs_.end(), id) == w.subs_.end()){
+            w.subs_.push_back(id);
+            subs_[id].wds_.push_back(wd);
+        }
+        return true;
+    }
+
+    // Under mutex_, every directory below dir. One that vanishes mid-walk is just skipped
+    void addTree(int id, const std::string &dir){
+        try{
+            DirWalker walk(dir);
+            walk.includeFiles(false).symlinks(DirWalker::Symlinks::SKIP);
+            for(auto &e : walk)
+                if(e.isDir())
+                    addWatch(id, std::string(e.path()));
+        }
+        catch(const std::runtime_error &){}
+    }
+
+    // Under mutex_, id no longer wants wd, the watch goes with its last sub
+    void dropWatch(int wd, int id){
+        auto w = wds_.find(wd);
+        if(w == wds_.end())
+            return;
+        auto &subs = w->second.subs_;
+        subs.erase(std::remove(subs.begin(), subs.end(), id), subs.end());
+        if(subs.empty()){
+            inotify_rm_watch(fd_, wd);
+            wds_.erase(w);
+        }
+    }
+
+    // Under mutex_
+    void queue(int id, const std::string &path, uint32_t kinds){
+        auto inserted = pending_.emplace(std::make_pair(id, path), pending_t{});
+        if(inserted.second)
+            inserted.first->second.due_ = clock::now() + coalesce_;
+        inserted.first->second.kinds_ |= kinds;
+    }
+
+    static uint32_t kindsOf(uint32_t mask){
+        uint32_t kinds = 0;
+        if(mask & (IN_MODIFY | IN_CLOSE_WRITE))
+            kinds |= MODIFIED;
+        if(mask & IN_ATTRIB)
+            kinds |= ATTRIB;
+        if(mask & IN_CREATE)
+            kinds |= CREATED;
+        if(mask & IN_DELETE)
+            kinds |= DELETED;
+        if(mask & IN_MOVED_TO)
+            kinds |= MOVED_IN;
+        if(mask & IN_MOVED_FROM)
+            kinds |= MOVED_OUT;
+        return kinds;
+    }
+
+    // Under mutex_
+    void handle(const struct inotify_event &ev){
+        if(ev.mask & IN_Q_OVERFLOW){
+            for(auto &sub : subs_)
+                queue(sub.first, sub.second.path_, OVERFLOW);
+            return;
+        }
+        auto found = wds_.find(ev.wd);
+        if(found == wds_.end())
+            return;
+        wd_t &w = found->second;
+
+        // The directory itself went away. A moved directory keeps its watch under a stale
+        // path, so drop it and everything below it; either way IN_IGNORED follows for each
+        if(ev.mask & (IN_DELETE_SELF | IN_MOVE_SELF)){
+            for(int id : w.subs_){
+                auto &sub = subs_[id];
+                if(!sub.name_.empty())
+                    queue(id, sub.path_, DELETED);
+                else if(sub.path_ == w.path_)
+                    queue(id, sub.path_, (ev.mask & IN_DELETE_SELF) ? DELETED : MOVED_OUT);
+            }
+            if(ev.mask & IN_MOVE_SELF){
+                std::string prefix = w.path_ + "/";
+                for(auto &other : wds_)
+                    if(other.first == ev.wd || other.second.path_.compare(0, prefix.size(), prefix) == 0)
+                        inotify_rm_watch(fd_, other.first);
+            }
+            return;
+        }
+        if(ev.mask & IN_IGNORED){
+            for(int id : w.subs_){
+                auto &sub = subs_[id];
+                sub.wds_.erase(std::remove(sub.wds_.begin(), sub.wds_.end(), ev.wd), sub.wds_.end());
+                if(!sub.name_.empty() || sub.path_ == w.path_)
+                    queue(id, sub.path_, UNWATCHED);
+            }
+            wds_.erase(found);
+            return;
+        }
+        if(ev.len == 0)
+            return;
+
+        std::string name(ev.name);
+        std::string path = w.path_ == "/" ? "/" + name : w.path_ + "/" + name;
+        uint32_t kinds = kindsOf(ev.mask);
+        bool new_dir = (ev.mask & IN_ISDIR) && (ev.mask & (IN_CREATE | IN_MOVED_TO));
+        // addWatch can rehash wds_ out from under w, work from a copy
+        std::vector<int> ids = w.subs_;
+        for(int id : ids){
+            auto &sub = subs_[id];
+            if(!sub.name_.empty()){
+                if(sub.name_ == name)
+                    queue(id, sub.path_, kinds);
+                continue;
+            }
+            queue(id, path, kinds);
+            if(sub.recursive_ && new_dir && addWatch(id, path))
+                addTree(id, path);
+        }
+    }
+
+    // Under mutex_, take everything that's due
+    std::vector<std::pair<std::shared_ptr<Callback>, Event>> due(clock::time_point now){
+        std::vector<std::pair<std::shared_ptr<Callback>, Event>> ready;
+        for(auto it = pending_.begin(); it != pending_.end();){
+            if(it->second.due_ > now){
+                ++it;
+                continue;
+            }
+            auto sub = subs_.find(it->first.first);
+            if(sub != subs_.end())
+                ready.emplace_back(sub->second.callback_, Event{it->first.second, it->second.kinds_});
+            it = pending_.erase(it);
+        }
+        return ready;
+    }
+
+    // Under mutex_, ms until the next pending event is due, -1 if there's none
+    int timeout(clock::time_point now){
+        if(pending_.empty())
+            return -1;
+        auto next = std::min_element(pending_.begin(), pending_.end(), [](auto &a, auto &b){
+            return a.second.due_ < b.second.due_;
+        })->second.due_;
+        if(next <= now)
+            return 0;
+        // Round up so the wait doesn't end just short of it
+        return static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            next - now + std::chrono::microseconds(999)).count());
+    }
+
+    void run(){
+        alignas(struct inotify_event) char buf[16 * 1024];
+        struct pollfd fds[2] = {{fd_, POLLIN, 0}, {stop_fd_, POLLIN, 0}};
+        int wait = -1;
+        while(true){
+            int n = poll(fds, 2, wait);
+            if(n < 0 && errno != EINTR)
+                break;
+            if(fds[1].revents & POLLIN)
+                break;
+
+            std::vector<std::pair<std::shared_ptr<Callback>, Event>> ready;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if(fds[0].revents & POLLIN){
+                    ssize_t len;
+                    while((len = ::read(fd_, buf, sizeof(buf))) > 0){
+                        for(char *p = buf; p < buf + len;){
+                            auto *ev = reinterpret_cast<struct inotify_event*>(p);
+                            p += sizeof(struct inotify_event) + ev->len;
+                            handle(*ev);
+                        }
+                    }
+                }
+                auto now = clock::now();
+                ready = due(now);
+                wait = timeout(now);
+            }
+            // Outside the lock so callbacks can watch and unwatch
+            for(auto &r : ready){
+                if(pool_){
+                    auto callback = r.first;
+                    pool_->push([callback](const Event &ev){ (*callback)(ev); }, std::move(r.second));
+                }
+                else{
+                    try{
+                        (*r.first)(r.second);
+                    }
+                    catch(...){}
+                }
+            }
+        }
+    }
+};
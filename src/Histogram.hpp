@@ -0,0 +1,248 @@
+//
+//  Histogram.hpp
+//  cppcommon
+//
+
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+
+/**
+    \brief Fixed log-linear bucket layout shared by Histogram and HistogramSnapshot
+    \details With precision p there are 2^p linear buckets per power of two, so any recorded value is
+    reported within a relative error of 2^-p (p = 7 is better than 1%). Values below 2^p are exact.
+    The full uint64_t range is covered, memory is (65 - p) * 2^p counters.
+*/
+class HistogramLayout{
+public:
+    explicit HistogramLayout(unsigned precision = 7)
+        : precision_(precision)
+        , sub_count_(uint64_t{1} << precision)
+    {
+        if(precision < 1 || precision > 16)
+            throw std::invalid_argument("Histogram precision must be between 1 and 16");
+    }
+
+    unsigned precision() const { return precision_; }
+    size_t buckets() const { return static_cast<size_t>((65 - precision_) * sub_count_); }
+
+    size_t index(uint64_t v) const {
+        if(v < sub_count_)
+            return static_cast<size_t>(v);
+        unsigned shift = highestBit(v) - precision_;
+        return static_cast<size_t>((shift + 1) * sub_count_ + ((v >> shift) - sub_count_));
+    }
+
+    // Smallest value that lands in bucket idx
+    uint64_t lowest(size_t idx) const {
+        if(idx < sub_count_)
+            return idx;
+        uint64_t shift = idx / sub_count_ - 1;
+        return (sub_count_ + idx % sub_count_) << shift;
+    }
+
+    // Largest value that lands in bucket idx
+    uint64_t highest(size_t idx) const {
+        if(idx < sub_count_)
+            return idx;
+        uint64_t shift = idx / sub_count_ - 1;
+        return lowest(idx) + ((uint64_t{1} << shift) - 1);
+    }
+
+private:
+    unsigned precision_;
+    uint64_t sub_count_;
+
+    // Position of the highest set bit, v must be non-zero
+    static unsigned highestBit(uint64_t v){
+#if defined(__GNUC__) || defined(__clang__)
+        return 63u - static_cast<unsigned>(__builtin_clzll(v));
+#else
+        unsigned bit = 0;
+        while(v >>= 1)
+            ++bit;
+        return bit;
+#endif
+    }
+};
+
+/**
+    \brief Plain (not thread safe) copy of a Histogram's counts that can be queried and merged
+    \date 10-18-26
+*/
+class HistogramSnapshot{
+public:
+    explicit HistogramSnapshot(unsigned precision = 7)
+        : layout_(precision)
+        , counts_(layout_.buckets(), 0)
+        {}
+
+    /**
+        \brief Add another snapshot's counts to this one
+        @throws std::invalid_argument if the precisions differ
+    */
+    HistogramSnapshot &merge(const HistogramSnapshot &other){
+        if(other.layout_.precision() != layout_.precision())
+            throw std::invalid_argument("Can't merge histograms with different precision");
+        for(size_t i = 0; i < counts_.size(); ++i)
+            counts_[i] += other.counts_[i];
+        if(other.count_){
+            min_ = count_ ? std::min(min_, other.min_) : other.min_;
+            max_ = std::max(max_, other.max_);
+        }
+        count_ += other.count_;
+        sum_ += other.sum_;
+        return *this;
+    }
+
+    uint64_t count() const { return count_; }
+    uint64_t min() const { return count_ ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    double mean() const { return count_ ? static_cast<double>(sum_) / count_ : 0.0; }
+
+    /**
+        \brief Value at percentile p
+        \details Returns the highest value equivalent to the bucket the percentile falls in, clamped
+        to the largest value recorded
+        @param p Percentile, 0 - 100
+        @return The value, 0 if nothing has been recorded
+    */
+    uint64_t percentile(double p) const {
+        if(!count_)
+            return 0;
+        p = std::min(100.0, std::max(0.0, p));
+        uint64_t target = static_cast<uint64_t>(std::ceil(p / 100.0 * count_));
+        if(target == 0)
+            target = 1;
+        uint64_t seen = 0;
+        for(size_t i = 0; i < counts_.size(); ++i){
+            seen += counts_[i];
+            if(seen >= target)
+                return std::min(layout_.highest(i), max_);
+        }
+        return max_;
+    }
+
+    uint64_t median() const { return percentile(50); }
+
+    /**
+        \brief Raw bucket counts, use layout() to map an index to its value range
+    */
+    const std::vector<uint64_t> &counts() const { return counts_; }
+    const HistogramLayout &layout() const { return layout_; }
+
+private:
+    friend class Histogram;
+
+    HistogramLayout layout_;
+    std::vector<uint64_t> counts_;
+    uint64_t count_{0};
+    uint64_t sum_{0};
+    uint64_t min_{0};
+    uint64_t max_{0};
+};
+
+/**
+    \brief Fixed memory high dynamic range histogram for latencies
+    \details Records uint64_t values (e.g. nanoseconds from Timer) into log-linear buckets, see
+    HistogramLayout for the precision / memory trade off. Memory never grows with the number of
+    values recorded.\n
+    record() is a relaxed atomic add on the value's bucket and on the running sum, safe to call
+    from any number of threads with no lock. Threads recording at a very high rate into the same
+    histogram will contend on the sum cache line; give each thread its own Histogram and
+    merge their snapshots instead. snapshot() can be taken while other threads record, it is
+    consistent per bucket but not across buckets.
+    \date 10-18-26
+*/
+class Histogram{
+public:
+    /**
+        \brief c'tor
+        @param precision Bits of sub-bucket precision, relative error is 2^-precision
+        @throws std::invalid_argument if precision isn't 1 - 16
+    */
+    explicit Histogram(unsigned precision = 7)
+        : layout_(precision)
+        , counts_(new std::atomic<uint64_t>[layout_.buckets()])
+    {
+        reset();
+    }
+
+    Histogram(const Histogram &) = delete;
+    Histogram &operator=(const Histogram &) = delete;
+
+    /**
+        \brief Record a value
+    */
+    void record(uint64_t value){
+        counts_[layout_.index(value)].fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+
+        // Only take the CAS path when the extreme actually moves, which quickly becomes rare
+        uint64_t cur = min_.load(std::memory_order_relaxed);
+        while(value < cur && !min_.compare_exchange_weak(cur, value, std::memory_order_relaxed)){}
+        cur = max_.load(std::memory_order_relaxed);
+        while(value > cur && !max_.compare_exchange_weak(cur, value, std::memory_order_relaxed)){}
+    }
+
+    /**
+        \brief Record a duration in nanoseconds, negative durations are recorded as 0
+    */
+    template <class Rep, class Period>
+    void record(std::chrono::duration<Rep, Period> d){
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+        record(static_cast<uint64_t>(ns < 0 ? 0 : ns));
+    }
+
+    /**
+        \brief Record a value in nanoseconds as returned by Timer::nanoseconds()
+    */
+    void recordNs(double ns){
+        record(static_cast<uint64_t>(ns < 0 || std::isnan(ns) ? 0 : std::llround(ns)));
+    }
+
+    /**
+        \brief Copy of the current counts, for queries or merging
+    */
+    HistogramSnapshot snapshot() const {
+        HistogramSnapshot snap(layout_.precision());
+        for(size_t i = 0; i < snap.counts_.size(); ++i){
+            snap.counts_[i] = counts_[i].load(std::memory_order_relaxed);
+            snap.count_ += snap.counts_[i];
+        }
+        snap.sum_ = sum_.load(std::memory_order_relaxed);
+        snap.min_ = min_.load(std::memory_order_relaxed);
+        snap.max_ = max_.load(std::memory_order_relaxed);
+        return snap;
+    }
+
+    /**
+        \brief Clear all counts, don't call while other threads are recording
+    */
+    void reset(){
+        for(size_t i = 0; i < layout_.buckets(); ++i)
+            counts_[i].store(0, std::memory_order_relaxed);
+        sum_.store(0, std::memory_order_relaxed);
+        min_.store(UINT64_MAX, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+    // Sums every bucket, use snapshot() when also querying percentiles
+    uint64_t count() const { return snapshot().count(); }
+    uint64_t percentile(double p) const { return snapshot().percentile(p); }
+    const HistogramLayout &layout() const { return layout_; }
+
+private:
+    HistogramLayout layout_;
+    std::unique_ptr<std::atomic<uint64_t>[]> counts_;
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> min_{UINT64_MAX};
+    std::atomic<uint64_t> max_{0};
+};
@@ -0,0 +1,117 @@
+//
+//  LineRange.hpp
+//  cppcommon
+//
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <iterator>
+#include <cstring>
+#include "MappedFile.hpp"
+
+/**
+    \brief Lazy range of the lines in a block of text, as std::string_views
+    \details Lines are split on '\n' and a '\r' before it is dropped, so CRLF files give the same
+    lines as LF files. Like std::getline, a final '\n' doesn't start an extra empty line. Newlines
+    are found with memchr, which the C library vectorizes, and nothing is copied or allocated per
+    line. The views point into the range's buffer, they're only valid while the range is alive.\n
+    Usually created through FSUtils::lines(path), e.g. \n
+    for(std::string_view line : FSUtils::lines("big.log")) \n
+        ...
+    \date 10-18-26
+*/
+class LineRange{
+public:
+    class iterator{
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const std::string_view *;
+        using reference = const std::string_view &;
+
+        iterator() = default;
+
+        iterator(const char *begin, const char *end)
+            : next_(begin)
+            , end_(end)
+        {
+            advance();
+        }
+
+        reference operator*() const { return line_; }
+        pointer operator->() const { return &line_; }
+
+        iterator &operator++(){
+            advance();
+            return *this;
+        }
+
+        iterator operator++(int){
+            iterator tmp = *this;
+            advance();
+            return tmp;
+        }
+
+        // The end iterator is the only one with no line
+        bool operator==(const iterator &other) const { return line_.data() == other.line_.data(); }
+        bool operator!=(const iterator &other) const { return !(*this == other); }
+
+    private:
+        const char *next_{nullptr};
+        const char *end_{nullptr};
+        std::string_view line_;
+
+        void advance(){
+            if(next_ == end_){
+                line_ = std::string_view();
+                return;
+            }
+            const char *nl = static_cast<const char *>(std::memchr(next_, '\n', end_ - next_));
+            const char *stop = nl ? nl : end_;
+            size_t len = static_cast<size_t>(stop - next_);
+            if(len && next_[len - 1] == '\r')
+                --len;
+            line_ = std::string_view(next_, len);
+            next_ = nl ? nl + 1 : end_;
+        }
+    };
+
+    /**
+        \brief Lines of text owned by someone else, text has to outlive the range
+    */
+    explicit LineRange(std::string_view text) : text_(text) {}
+
+    /**
+        \brief Lines of a mapped file, the range keeps the mapping alive
+    */
+    explicit LineRange(MappedFile &&file)
+        : file_(std::move(file))
+        , text_(file_.view())
+        {}
+
+    /**
+        \brief Lines of a string, the range keeps the string alive
+    */
+    explicit LineRange(std::string &&text)
+        : owned_(new std::string(std::move(text)))
+        , text_(*owned_)
+        {}
+
+    iterator begin() const { return iterator(text_.data(), text_.data() + text_.size()); }
+    iterator end() const { return iterator(); }
+
+    /**
+        \brief The whole text the lines come from
+    */
+    std::string_view text() const { return text_; }
+
+private:
+    // Both keep their data at a fixed address when the range is moved, so text_ stays valid
+    MappedFile file_;
+    std::unique_ptr<std::string> owned_;
+    std::string_view text_;
+};
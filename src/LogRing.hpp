@@ -0,0 +1,251 @@
+//
+//  LogRing.hpp
+//  cppcommon
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "TimeStamp.hpp"
+
+/**
+    \brief A single record decoded from a LogRing file
+*/
+struct logrecord_t{
+    uint64_t seq_;
+    int64_t time_ns_;
+    std::string type_;
+    std::string text_;
+};
+
+/**
+    \brief Crash-safe flight recorder log ring
+    \details Fixed number of fixed size slots in a memory mapped (MAP_SHARED) file. Writing a record
+    is one atomic increment and a memcpy into the mapping, there is no write() or fsync() per record.
+    Because the pages belong to the file, everything written is still there when the process
+    crashes, is killed, or calls abort(); use LogRing::decode / LogRing::dump to read it back. It does
+    not protect against the machine itself going down before the kernel writes the pages back.\n
+    Any number of threads can write at the same time. Records longer than the slot are truncated,
+    and once the ring is full the oldest records are overwritten. Reopening an existing ring file
+    with the same geometry continues after the records already in it.
+    \date 10-18-26
+*/
+class LogRing{
+public:
+    /**
+        \brief Open or create a ring file
+        @param path Path to the ring file, created if it doesn't exist
+        @param slots Number of records the ring holds
+        @param slot_size Bytes per record, including a 32 byte record header. Rounded up to a
+        multiple of 8, minimum 64
+        @throws std::runtime_error if the file can't be created or mapped
+    */
+    LogRing(const std::string &path, size_t slots = 4096, size_t slot_size = 256)
+        : slots_(slots ? slots : 1)
+        , slot_size_(std::max<size_t>(64, (slot_size + 7) & ~static_cast<size_t>(7)))
+        , map_size_(sizeof(ringheader_t) + slots_ * slot_size_)
+    {
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if(fd == -1)
+            throw std::runtime_error("Couldn't open " + path);
+
+        struct stat st;
+        bool reuse = fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) == map_size_;
+        if(!reuse && ftruncate(fd, static_cast<off_t>(map_size_)) != 0){
+            ::close(fd);
+            throw std::runtime_error("Couldn't size " + path);
+        }
+
+        void *map = mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(map == MAP_FAILED)
+            throw std::runtime_error("Couldn't map " + path);
+        base_ = static_cast<char *>(map);
+
+        ringheader_t *hdr = header();
+        if(!reuse || !valid(*hdr, map_size_) || hdr->slots_ != slots_ || hdr->slot_size_ != slot_size_){
+            std::memset(base_, 0, map_size_);
+            hdr->slots_ = slots_;
+            hdr->slot_size_ = slot_size_;
+            std::memcpy(hdr->magic_, MAGIC, sizeof(hdr->magic_));
+        }
+    }
+
+    LogRing(const LogRing &) = delete;
+    LogRing &operator=(const LogRing &) = delete;
+
+    ~LogRing(){
+        if(base_)
+            munmap(base_, map_size_);
+    }
+
+    /**
+        \brief Write a record
+        @param type Short record type, e.g. "INFO", truncated to 11 characters
+        @param text Record text, truncated to fit the slot
+        @param time_ns Nanoseconds since the (system_clock) epoch
+    */
+    void write(const std::string &type, const std::string &text, int64_t time_ns){
+        uint64_t seq = next().fetch_add(1, std::memory_order_relaxed);
+        char *slot = base_ + sizeof(ringheader_t) + (seq % slots_) * slot_size_;
+        auto *rec = reinterpret_cast<slotheader_t *>(slot);
+        auto *committed = reinterpret_cast<std::atomic<uint64_t> *>(&rec->committed_);
+
+        // 0 marks the slot as being written, a crash mid-write leaves the slot skipped by decode
+        committed->store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        rec->time_ns_ = time_ns;
+        size_t type_len = std::min(type.size(), sizeof(rec->type_) - 1);
+        std::memcpy(rec->type_, type.data(), type_len);
+        rec->type_[type_len] = '\0';
+        size_t len = std::min(text.size(), slot_size_ - sizeof(slotheader_t));
+        std::memcpy(slot + sizeof(slotheader_t), text.data(), len);
+        rec->len_ = static_cast<uint32_t>(len);
+
+        committed->store(seq + 1, std::memory_order_release);
+    }
+
+    /**
+        \brief Write a record stamped with the current time
+        @param type Short record type, e.g. "INFO", truncated to 11 characters
+        @param text Record text, truncated to fit the slot
+    */
+    void write(const std::string &type, const std::string &text){
+        write(type, text, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              std::chrono::system_clock::now().time_since_epoch()).count());
+    }
+
+    /**
+        \brief Number of records the ring holds
+    */
+    size_t slots() const { return slots_; }
+
+    /**
+        \brief Bytes per record, including the record header
+    */
+    size_t slotSize() const { return slot_size_; }
+
+    /**
+        \brief Read every complete record out of a ring file, oldest first
+        \details The file is mapped read-only, nothing is modified. Slots that were being written
+        when the process died are skipped.
+        @param path Path to the ring file
+        @return The records, ordered by sequence number
+        @throws std::runtime_error if path can't be opened or isn't a ring file
+    */
+    static std::vector<logrecord_t> decode(const std::string &path){
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd == -1)
+            throw std::runtime_error("Couldn't open " + path);
+        struct stat st;
+        if(fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ringheader_t)){
+            ::close(fd);
+            throw std::runtime_error(path + " is not a log ring");
+        }
+        size_t size = static_cast<size_t>(st.st_size);
+        void *map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(map == MAP_FAILED)
+            throw std::runtime_error("Couldn't map " + path);
+
+        const char *base = static_cast<const char *>(map);
+        const auto *hdr = reinterpret_cast<const ringheader_t *>(base);
+        if(!valid(*hdr, size)){
+            munmap(map, size);
+            throw std::runtime_error(path + " is not a log ring");
+        }
+
+        std::vector<logrecord_t> records;
+        for(size_t i = 0; i < hdr->slots_; ++i){
+            const char *slot = base + sizeof(ringheader_t) + i * hdr->slot_size_;
+            const auto *rec = reinterpret_cast<const slotheader_t *>(slot);
+            if(!rec->committed_ || rec->len_ > hdr->slot_size_ - sizeof(slotheader_t))
+                continue;
+            logrecord_t r;
+            r.seq_ = rec->committed_ - 1;
+            r.time_ns_ = rec->time_ns_;
+            r.type_.assign(rec->type_, strnlen(rec->type_, sizeof(rec->type_)));
+            r.text_.assign(slot + sizeof(slotheader_t), rec->len_);
+            records.push_back(std::move(r));
+        }
+        munmap(map, size);
+
+        std::sort(records.begin(), records.end(),
+                  [](const logrecord_t &a, const logrecord_t &b){ return a.seq_ < b.seq_; });
+        return records;
+    }
+
+    /**
+        \brief Decode a ring file and write it out as "time TYPE: text" lines, oldest first
+        @param path Path to the ring file
+        @param out Stream to write the records to
+        @return Number of records written
+        @throws std::runtime_error if path can't be opened or isn't a ring file
+    */
+    static size_t dump(const std::string &path, std::ostream &out){
+        TimeStamp stamp;
+        auto records = decode(path);
+        for(auto &&r : records){
+            std::chrono::system_clock::time_point tp{
+                std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                    std::chrono::nanoseconds(r.time_ns_))};
+            out << stamp.format(tp) << " " << r.type_ << ": " << r.text_ << '\n';
+        }
+        return records.size();
+    }
+
+private:
+    static constexpr const char *MAGIC = "TSLRING1";
+
+    struct ringheader_t{
+        char magic_[8];
+        uint64_t slots_;
+        uint64_t slot_size_;
+        uint64_t next_;
+        uint64_t reserved_[4];
+    };
+
+    // committed_ is 0 while the slot is being written, sequence number + 1 once complete
+    struct slotheader_t{
+        uint64_t committed_;
+        int64_t time_ns_;
+        uint32_t len_;
+        char type_[12];
+    };
+
+    static_assert(sizeof(ringheader_t) == 64, "ring header must stay 64 bytes");
+    static_assert(sizeof(slotheader_t) == 32, "slot header must stay 32 bytes");
+    static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t), "atomic must be address free");
+
+    size_t slots_;
+    size_t slot_size_;
+    size_t map_size_;
+    char *base_{nullptr};
+
+    ringheader_t *header() const { return reinterpret_cast<ringheader_t *>(base_); }
+
+    // The counter lives in the mapping so a reopened ring carries on where the last process stopped
+    std::atomic<uint64_t> &next() const {
+        return *reinterpret_cast<std::atomic<uint64_t> *>(&header()->next_);
+    }
+
+    static bool valid(const ringheader_t &hdr, size_t file_size){
+        return std::memcmp(hdr.magic_, MAGIC, sizeof(hdr.magic_)) == 0
+            && hdr.slot_size_ >= 64
+            && hdr.slots_ > 0
+            && sizeof(ringheader_t) + hdr.slots_ * hdr.slot_size_ == file_size;
+    }
+};
@@ -0,0 +1,146 @@
+//
+//  MappedFile.hpp
+//  cppcommon
+//
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+    \brief Read only memory mapped file
+    \details Maps the whole file, so its contents can be used in place as a std::string_view
+    without reading them into process memory; pages are loaded (and can be dropped again) by the
+    kernel as they're touched, so a file larger than RAM can still be mapped. Hints are passed to
+    madvise, they're only hints and failures are ignored:\n
+    - SEQUENTIAL - read ahead aggressively, free pages soon after they're read (default) \n
+    - RANDOM - don't read ahead \n
+    - WILLNEED - start reading the whole file in now \n
+    - HUGEPAGES - back the mapping with transparent huge pages where the kernel supports it for
+    files (needs CONFIG_READ_ONLY_THP_FOR_FS), fewer TLB misses on big files \n
+    Hints can be combined, e.g. MappedFile f(path, MappedFile::SEQUENTIAL | MappedFile::WILLNEED);\n
+    An empty file gives an empty view. The view is only valid while the MappedFile is alive, and
+    is undefined if another process truncates the file while it's mapped.
+    \date 10-18-26
+*/
+class MappedFile{
+public:
+    enum Advice{
+        NORMAL = 0,
+        SEQUENTIAL = 1,
+        RANDOM = 2,
+        WILLNEED = 4,
+        HUGEPAGES = 8
+    };
+
+    /**
+        \brief Empty mapping
+    */
+    MappedFile() = default;
+
+    /**
+        \brief Map a file
+        @param path Path to the file
+        @param advice Advice flags, combined with |
+        @throws std::runtime_error if the file can't be opened, isn't a regular file, or can't be
+        mapped
+    */
+    explicit MappedFile(const std::string &path, int advice = SEQUENTIAL){
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd == -1)
+            throw std::runtime_error("Couldn't open " + path);
+        struct stat st;
+        if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)){
+            close(fd);
+            throw std::runtime_error("Couldn't map " + path + ", not a regular file");
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if(size_){
+            void *p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            int err = errno;
+            close(fd);
+            if(p == MAP_FAILED){
+                size_ = 0;
+                throw std::runtime_error("Couldn't map " + path + ": " + std::strerror(err));
+            }
+            data_ = static_cast<const char *>(p);
+            advise(advice);
+        }
+        else
+            close(fd);
+    }
+
+    ~MappedFile() { unmap(); }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    MappedFile(MappedFile &&other) noexcept
+        : data_(other.data_)
+        , size_(other.size_)
+    {
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+
+    MappedFile &operator=(MappedFile &&other) noexcept {
+        if(this != &other){
+            unmap();
+            data_ = other.data_;
+            size_ = other.size_;
+            other.data_ = nullptr;
+            other.size_ = 0;
+        }
+        return *this;
+    }
+
+    /**
+        \brief Pass new hints for the whole mapping
+        @param advice Advice flags, combined with |
+    */
+    void advise(int advice){
+        if(!data_)
+            return;
+        void *p = const_cast<char *>(data_);
+        if(advice & SEQUENTIAL)
+            madvise(p, size_, MADV_SEQUENTIAL);
+        if(advice & RANDOM)
+            madvise(p, size_, MADV_RANDOM);
+        if(advice & WILLNEED)
+            madvise(p, size_, MADV_WILLNEED);
+#ifdef MADV_HUGEPAGE
+        if(advice & HUGEPAGES)
+            madvise(p, size_, MADV_HUGEPAGE);
+#endif
+    }
+
+    const char *data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const char *begin() const { return data_; }
+    const char *end() const { return data_ + size_; }
+
+    /**
+        \brief The file contents
+    */
+    std::string_view view() const { return std::string_view(data_, size_); }
+
+private:
+    const char *data_{nullptr};
+    size_t size_{0};
+
+    void unmap(){
+        if(data_)
+            munmap(const_cast<char *>(data_), size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+};
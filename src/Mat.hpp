@@ -93,6 +93,17 @@ public:
         mat_ = points;
     }
     
+    // Take ownership of row major values, without copying them
+    Mat(std::vector<num_t> &&points, size_t rows, size_t cols)
+    : rows_(rows)
+    , cols_(rows_ ? cols : 0)
+    , size_(rows_ * cols_)
+    {
+        if(points.size() != size_)
+            throw std::logic_error("rows * cols != size...why?");
+        mat_ = std::move(points);
+    }
+    
     // Create a diagonal matrix based on val
     Mat(num_t val, size_t rows = DEFAULT_ROWS, size_t cols = DEFAULT_COLS)
     : rows_(rows)
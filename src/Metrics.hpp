@@ -0,0 +1,517 @@
+//
+//  Metrics.hpp
+//  cppcommon
+//
+
+#pragma once
+
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
+#include <sstream>
+#include <fstream>
+#include <stdexcept>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+#include <charconv>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include "Histogram.hpp"
+#include "Timer.hpp"
+#include "ThreadPool.hpp"
+#include "TSQueue.hpp"
+#include "TSLogger.hpp"
+
+/**
+    \brief Monotonic counter, sharded so threads incrementing it don't contend
+    \details Each thread is assigned one of SHARDS cache line sized slots the first time it
+    increments any counter, inc() is a relaxed add on that slot which no other thread touches
+    (unless there are more than SHARDS threads). value() sums the slots.
+    \date 10-18-26
+*/
+class Counter{
+public:
+    void inc(uint64_t n = 1){
+        shards_[shard()].value_.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const {
+        uint64_t total = 0;
+        for(size_t i = 0; i < SHARDS; ++i)
+            total += shards_[i].value_.load(std::memory_order_relaxed);
+        return total;
+    }
+
+private:
+    static const size_t SHARDS = 16;
+
+    // Padded rather than aligned, the values are still 64 bytes apart
+    struct shard_t{
+        std::atomic<uint64_t> value_{0};
+        char pad_[64 - sizeof(std::atomic<uint64_t>)];
+    };
+    shard_t shards_[SHARDS];
+
+    static size_t shard(){
+        static std::atomic<size_t> next{0};
+        thread_local size_t idx = next.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+        return idx;
+    }
+};
+
+/**
+    \brief Value that can go up and down, e.g. queue depth
+*/
+class Gauge{
+public:
+    void set(double v) { value_.store(v, std::memory_order_relaxed); }
+
+    void add(double delta){
+        double cur = value_.load(std::memory_order_relaxed);
+        while(!value_.compare_exchange_weak(cur, cur + delta, std::memory_order_relaxed)){}
+    }
+
+    double value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<double> value_{0.0};
+};
+
+/**
+    \brief Latency distribution backed by a Histogram, values in nanoseconds
+    \details Record Timer results directly, or time a scope with ScopedTimer
+*/
+class TimerMetric{
+public:
+    void record(uint64_t ns) { hist_.record(ns); }
+    void recordNs(double ns) { hist_.recordNs(ns); }
+
+    template <class Rep, class Period>
+    void record(std::chrono::duration<Rep, Period> d) { hist_.record(d); }
+
+    HistogramSnapshot snapshot() const { return hist_.snapshot(); }
+
+private:
+    Histogram hist_;
+};
+
+/**
+    \brief Records the lifetime of the scope into a TimerMetric
+*/
+class ScopedTimer{
+public:
+    explicit ScopedTimer(TimerMetric &metric) : metric_(metric) { timer_.startTimer(); }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+    ~ScopedTimer(){
+        timer_.stopTimer();
+        metric_.recordNs(timer_.nanoseconds());
+    }
+
+private:
+    TimerMetric &metric_;
+    Timer timer_;
+};
+
+/**
+    \brief Named counters, gauges, and timers, rendered as Prometheus text
+    \details Looking a metric up takes a lock, so do it once and keep the reference, which stays
+    valid for the life of the registry. Updating a metric never locks. Names must be valid
+    Prometheus names ([a-zA-Z_:][a-zA-Z0-9_:]*). Timers are exported as summaries in seconds with
+    0.5 / 0.9 / 0.99 / 0.999 quantiles. e.g. \n
+    Counter &requests = MetricsRegistry::global().counter("requests_total", "Requests served"); \n
+    requests.inc();
+    \date 10-18-26
+*/
+class MetricsRegistry{
+public:
+    /**
+        \brief Process wide registry, never destroyed so metrics can be used during static
+        destruction
+    */
+    static MetricsRegistry &global(){
+        static MetricsRegistry *reg = new MetricsRegistry;
+        return *reg;
+    }
+
+    /**
+        \brief Get or create a counter
+        @throws std::invalid_argument if the name is invalid or used by a different metric type
+    */
+    Counter &counter(const std::string &name, const std::string &help = ""){
+        return get(counters_, name, help);
+    }
+
+    /**
+        \brief Get or create a gauge
+        @throws std::invalid_argument if the name is invalid or used by a different metric type
+    */
+    Gauge &gauge(const std::string &name, const std::string &help = ""){
+        return get(gauges_, name, help);
+    }
+
+    /**
+        \brief Get or create a timer
+        @throws std::invalid_argument if the name is invalid or used by a different metric type
+    */
+    TimerMetric &timer(const std::string &name, const std::string &help = ""){
+        return get(timers_, name, help);
+    }
+
+    /**
+        \brief Write every metric in the Prometheus text exposition format
+    */
+    void writePrometheus(std::ostream &out) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for(auto &&kv : counters_){
+            writeHeader(out, kv.first, "counter");
+            out << kv.first << ' ' << kv.second->value() << '\n';
+        }
+        for(auto &&kv : gauges_){
+            writeHeader(out, kv.first, "gauge");
+            out << kv.first << ' ';
+            writeValue(out, kv.second->value());
+            out << '\n';
+        }
+        for(auto &&kv : timers_){
+            writeHeader(out, kv.first, "summary");
+            auto snap = kv.second->snapshot();
+            for(double q : {0.5, 0.9, 0.99, 0.999}){
+                out << kv.first << "{quantile=\"" << q << "\"} ";
+                writeValue(out, snap.percentile(q * 100) / 1e9);
+                out << '\n';
+            }
+            out << kv.first << "_sum ";
+            writeValue(out, snap.mean() * snap.count() / 1e9);
+            out << '\n' << kv.first << "_count " << snap.count() << '\n';
+        }
+    }
+
+    /**
+        \brief writePrometheus into a string
+    */
+    std::string prometheusText() const {
+        std::ostringstream out;
+        writePrometheus(out);
+        return out.str();
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<Counter>> counters_;
+    std::map<std::string, std::unique_ptr<Gauge>> gauges_;
+    std::map<std::string, std::unique_ptr<TimerMetric>> timers_;
+    std::map<std::string, std::string> help_;
+
+    template <class M>
+    M &get(std::map<std::string, std::unique_ptr<M>> &metrics, const std::string &name,
+           const std::string &help){
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = metrics.find(name);
+        if(it != metrics.end())
+            return *it->second;
+        if(!validName(name))
+            throw std::invalid_argument("Invalid metric name: " + name);
+        if(help_.count(name))
+            throw std::invalid_argument("Metric already registered with a different type: " + name);
+        help_[name] = help;
+        return *metrics.emplace(name, std::unique_ptr<M>(new M)).first->second;
+    }
+
+    static bool validName(const std::string &name){
+        if(name.empty() || (name[0] >= '0' && name[0] <= '9'))
+            return false;
+        for(char ch : name){
+            bool ok = (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9')
+                || ch == '_' || ch == ':';
+            if(!ok)
+                return false;
+        }
+        return true;
+    }
+
+    void writeHeader(std::ostream &out, const std::string &name, const char *type) const {
+        auto it = help_.find(name);
+        if(it != help_.end() && !it->second.empty()){
+            out << "# HELP " << name << ' ';
+            for(char ch : it->second){
+                if(ch == '\\') out << "\\\\";
+                else if(ch == '\n') out << "\\n";
+                else out << ch;
+            }
+            out << '\n';
+        }
+        out << "# TYPE " << name << ' ' << type << '\n';
+    }
+
+    // Shortest text that reads back as the same double, the stream's default 6 digits would round
+    static void writeValue(std::ostream &out, double v){
+        if(std::isnan(v)){
+            out << "NaN";
+            return;
+        }
+        if(std::isinf(v)){
+            out << (v > 0 ? "+Inf" : "-Inf");
+            return;
+        }
+        char buf[32];
+        auto res = std::to_chars(buf, buf + sizeof(buf), v);
+        out.write(buf, res.ptr - buf);
+    }
+};
+
+/**
+    \brief Periodically exports a MetricsRegistry in Prometheus text format
+    \details FILE rewrites the file every interval (written to path.tmp then renamed, so readers
+    such as the node_exporter textfile collector never see a partial file) and once more on
+    destruction. UNIX_SOCKET listens on a Unix domain stream socket at path and writes a fresh
+    snapshot to each client that connects, then closes the connection, e.g. \n
+    socat - UNIX-CONNECT:/tmp/app.metrics
+    \date 10-18-26
+*/
+class MetricsExporter{
+public:
+    enum class Target{ FILE, UNIX_SOCKET };
+
+    /**
+        \brief c'tor, starts the exporter thread
+        @param registry Registry to export, must outlive the exporter
+        @param path File to write, or socket path to listen on (an existing file there is replaced)
+        @param target FILE or UNIX_SOCKET
+        @param interval How often the file is rewritten, unused for UNIX_SOCKET
+        @throws std::runtime_error if the socket can't be created
+    */
+    MetricsExporter(MetricsRegistry &registry, const std::string &path, Target target = Target::FILE,
+                    std::chrono::milliseconds interval = std::chrono::milliseconds(10000))
+        : registry_(registry)
+        , path_(path)
+        , target_(target)
+        , interval_(interval)
+    {
+        if(target_ == Target::UNIX_SOCKET)
+            listen_fd_ = listenOn(path_);
+        worker_ = std::thread(&MetricsExporter::run, this);
+    }
+
+    MetricsExporter(const MetricsExporter &) = delete;
+    MetricsExporter &operator=(const MetricsExporter &) = delete;
+
+    ~MetricsExporter(){
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cond_.notify_all();
+        if(worker_.joinable())
+            worker_.join();
+        if(listen_fd_ >= 0){
+            close(listen_fd_);
+            unlink(path_.c_str());
+        }
+    }
+
+    /**
+        \brief Write the file immediately, FILE target only
+        @return True if the file was written
+    */
+    bool exportNow(){
+        if(target_ != Target::FILE)
+            return false;
+        // The exporter thread writes the same tmp file
+        std::lock_guard<std::mutex> lock(export_mutex_);
+        std::string tmp = path_ + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::out | std::ios::trunc);
+            if(!out)
+                return false;
+            registry_.writePrometheus(out);
+            if(!out.flush())
+                return false;
+        }
+        return std::rename(tmp.c_str(), path_.c_str()) == 0;
+    }
+
+private:
+    MetricsRegistry &registry_;
+    std::string path_;
+    Target target_;
+    std::chrono::milliseconds interval_;
+    int listen_fd_{-1};
+    std::mutex mutex_;
+    std::mutex export_mutex_;
+    std::condition_variable cond_;
+    bool stop_{false};
+    std::thread worker_;
+
+    void run(){
+        if(target_ == Target::FILE){
+            std::unique_lock<std::mutex> lock(mutex_);
+            while(!stop_){
+                lock.unlock();
+                exportNow();
+                lock.lock();
+                cond_.wait_for(lock, interval_, [this]{ return stop_; });
+            }
+            lock.unlock();
+            exportNow();
+            return;
+        }
+
+        while(true){
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if(stop_)
+                    return;
+            }
+            // Short timeout so the d'tor doesn't wait long for the thread
+            pollfd pfd{listen_fd_, POLLIN, 0};
+            if(poll(&pfd, 1, 100) <= 0)
+                continue;
+            int client = accept(listen_fd_, nullptr, nullptr);
+            if(client < 0)
+                continue;
+            std::string text = registry_.prometheusText();
+            const char *p = text.data();
+            size_t left = text.size();
+            while(left){
+                ssize_t n = send(client, p, left, MSG_NOSIGNAL);
+                if(n < 0 && errno == EINTR)
+                    continue;
+                if(n <= 0)
+                    break;
+                p += n;
+                left -= static_cast<size_t>(n);
+            }
+            close(client);
+        }
+    }
+
+    static int listenOn(const std::string &path){
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if(path.size() >= sizeof(addr.sun_path))
+            throw std::runtime_error("Metrics socket path too long: " + path);
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(fd < 0)
+            throw std::runtime_error("Can't create metrics socket: " + std::string(std::strerror(errno)));
+        unlink(path.c_str());
+        if(bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(fd, 16) != 0){
+            int err = errno;
+            close(fd);
+            throw std::runtime_error("Can't listen on metrics socket " + path + ": " + std::strerror(err));
+        }
+        return fd;
+    }
+};
+
+// publishMetrics for ThreadPool, TSQueue and TSLogger live here so their headers don't need this one
+
+inline void ThreadPool::publishMetrics(MetricsRegistry &registry, const std::string &prefix){
+    struct published_t : metrics_t{
+        published_t(MetricsRegistry &registry, const std::string &prefix)
+            : submitted_(registry.counter(prefix + "_tasks_submitted_total",
+                                          "Tasks pushed onto the pool"))
+            , completed_(registry.counter(prefix + "_tasks_completed_total",
+                                          "Tasks the pool has finished running"))
+            , depth_(registry.gauge(prefix + "_queue_depth", "Tasks waiting for a worker"))
+            , latency_(registry.timer(prefix + "_task_seconds", "Time spent running each task"))
+            {}
+
+        void submitted() override { submitted_.inc(); }
+        void queued(size_t depth) override { depth_.set(static_cast<double>(depth)); }
+
+        void run(const std::function<void()> &task) override {
+            {
+                ScopedTimer timed(latency_);
+                task();
+            }
+            completed_.inc();
+        }
+
+        Counter &submitted_;
+        Counter &completed_;
+        Gauge &depth_;
+        TimerMetric &latency_;
+    };
+
+    if(mMetrics.load())
+        return;
+    mMetricsOwner.reset(new published_t(registry, prefix));
+    std::lock_guard<std::mutex> lock(mQueueMutex);
+    mMetricsOwner->queued(mTasks.size());
+    mMetrics.store(mMetricsOwner.get(), std::memory_order_release);
+}
+
+template <class T>
+void TSQueue<T>::publishMetrics(MetricsRegistry &registry, const std::string &prefix){
+    struct published_t : metrics_t{
+        published_t(MetricsRegistry &registry, const std::string &prefix)
+            : pushed_total_(registry.counter(prefix + "_pushed_total", "Items pushed onto the queue"))
+            , popped_total_(registry.counter(prefix + "_popped_total", "Items popped off the queue"))
+            , depth_(registry.gauge(prefix + "_depth", "Items currently in the queue"))
+            {}
+
+        void pushed(size_t depth) override {
+            pushed_total_.inc();
+            depth_.set(static_cast<double>(depth));
+        }
+
+        void popped(size_t depth) override {
+            popped_total_.inc();
+            depth_.set(static_cast<double>(depth));
+        }
+
+        void resized(size_t depth) override { depth_.set(static_cast<double>(depth)); }
+
+        Counter &pushed_total_;
+        Counter &popped_total_;
+        Gauge &depth_;
+    };
+
+    std::shared_ptr<metrics_t> metrics = std::make_shared<published_t>(registry, prefix);
+    std::unique_lock<std::mutex> mlock(mutex_);
+    metrics_ = metrics;
+    metrics_->resized(queue_.size());
+}
+
+inline void TSLogger::publishMetrics(MetricsRegistry &registry, const std::string &prefix){
+    struct published_t : metrics_t{
+        published_t(MetricsRegistry &registry, const std::string &prefix)
+            : messages_(registry.counter(prefix + "_messages_total", "Messages accepted by the logger"))
+            , rate_limited_(registry.counter(prefix + "_rate_limited_total",
+                                             "Messages dropped by the rate limit"))
+            , overflow_(registry.counter(prefix + "_overflow_total",
+                                         "Messages that overflowed a per-thread queue"))
+            , written_(registry.counter(prefix + "_lines_written_total", "Lines written to the log file"))
+            {}
+
+        void accepted() override { messages_.inc(); }
+        void rateLimited() override { rate_limited_.inc(); }
+        void overflowed() override { overflow_.inc(); }
+        void written() override { written_.inc(); }
+
+        Counter &messages_;
+        Counter &rate_limited_;
+        Counter &overflow_;
+        Counter &written_;
+    };
+
+    if(metrics_)
+        return;
+    metrics_owner_.reset(new published_t(registry, prefix));
+    metrics_.store(metrics_owner_.get(), std::memory_order_release);
+}
@@ -0,0 +1,227 @@
+//
+//  PerfCounters.hpp
+//  cppcommon
+//
+
+#pragma once
+
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#if defined(__linux__)
+    #include <linux/perf_event.h>
+    #include <sys/syscall.h>
+    #include <sys/ioctl.h>
+    #include <unistd.h>
+#endif
+
+/**
+    \brief Hardware performance counters for a region of code, via Linux perf_event_open
+    \details Started and stopped like Timer. Counts only the calling thread, user space only, so
+    create, start, and stop it on the thread doing the work. Each counter is opened on its own, a
+    counter the CPU or kernel doesn't support (or that perf_event_paranoid forbids, common in
+    containers and VMs) is simply unavailable and reported as such; everything else still works.
+    When the kernel has to multiplex counters the values are scaled by the fraction of time each
+    counter was actually running. e.g. \n
+    PerfCounters pc; \n
+    pc.startCounters(); \n
+    ... \n
+    pc.stopCounters(); \n
+    std::cout << pc.report() << '\\n';
+    \date 10-18-26
+*/
+class PerfCounters{
+public:
+    enum Event{
+        CYCLES,
+        INSTRUCTIONS,
+        L1D_MISSES,
+        LLC_MISSES,
+        BRANCH_MISSES,
+        EVENT_COUNT
+    };
+
+    /**
+        \brief c'tor, opens every counter for the calling thread
+    */
+    PerfCounters(){
+        for(int e = 0; e < EVENT_COUNT; ++e){
+            fds_[e] = openEvent(static_cast<Event>(e));
+            values_[e] = 0;
+        }
+    }
+
+    ~PerfCounters(){
+#if defined(__linux__)
+        for(int e = 0; e < EVENT_COUNT; ++e)
+            if(fds_[e] >= 0)
+                close(fds_[e]);
+#endif
+    }
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    /**
+        \brief True if at least one counter could be opened
+    */
+    bool available() const {
+        for(int e = 0; e < EVENT_COUNT; ++e)
+            if(fds_[e] >= 0)
+                return true;
+        return false;
+    }
+
+    /**
+        \brief True if counter e could be opened
+    */
+    bool available(Event e) const { return fds_[e] >= 0; }
+
+    /**
+        \brief Why counters are unavailable, empty if every counter opened
+    */
+    const std::string &error() const { return error_; }
+
+    /**
+        \brief reset and start every available counter
+    */
+    void startCounters(){
+#if defined(__linux__)
+        for(int e = 0; e < EVENT_COUNT; ++e){
+            if(fds_[e] < 0)
+                continue;
+            ioctl(fds_[e], PERF_EVENT_IOC_RESET, 0);
+            ioctl(fds_[e], PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    /**
+        \brief stop every available counter and read its value
+    */
+    void stopCounters(){
+#if defined(__linux__)
+        for(int e = 0; e < EVENT_COUNT; ++e)
+            if(fds_[e] >= 0)
+                ioctl(fds_[e], PERF_EVENT_IOC_DISABLE, 0);
+        for(int e = 0; e < EVENT_COUNT; ++e){
+            values_[e] = 0;
+            if(fds_[e] < 0)
+                continue;
+            // value, time enabled, time running
+            uint64_t buf[3] = {0, 0, 0};
+            if(read(fds_[e], buf, sizeof(buf)) != static_cast<ssize_t>(sizeof(buf)))
+                continue;
+            if(buf[2] && buf[2] < buf[1])
+                buf[0] = static_cast<uint64_t>(static_cast<double>(buf[0]) * buf[1] / buf[2]);
+            values_[e] = buf[0];
+        }
+#endif
+    }
+
+    /**
+        \brief Count of event e between startCounters and stopCounters, 0 if unavailable
+    */
+    uint64_t value(Event e) const { return values_[e]; }
+
+    /**
+        \brief Instructions per cycle, 0 if either counter is unavailable
+    */
+    double ipc() const {
+        if(!values_[CYCLES])
+            return 0.0;
+        return static_cast<double>(values_[INSTRUCTIONS]) / values_[CYCLES];
+    }
+
+    /**
+        \brief Short name of event e, e.g. "cycles"
+    */
+    static const char *name(Event e){
+        static const char *names[EVENT_COUNT] = {
+            "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"
+        };
+        return names[e];
+    }
+
+    /**
+        \brief One line summary, name=value for every counter, "unavailable" for those that aren't
+    */
+    std::string report() const {
+        std::ostringstream out;
+        for(int e = 0; e < EVENT_COUNT; ++e){
+            out << (e ? " " : "") << name(static_cast<Event>(e)) << '=';
+            if(fds_[e] >= 0)
+                out << values_[e];
+            else
+                out << "unavailable";
+        }
+        out << " ipc=";
+        if(available(CYCLES) && available(INSTRUCTIONS))
+            out << std::fixed << std::setprecision(2) << ipc();
+        else
+            out << "unavailable";
+        return out.str();
+    }
+
+private:
+    int fds_[EVENT_COUNT];
+    uint64_t values_[EVENT_COUNT];
+    std::string error_;
+
+    int openEvent(Event e){
+#if defined(__linux__)
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        const uint64_t read_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        switch(e){
+            case CYCLES:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                break;
+            case INSTRUCTIONS:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                break;
+            case L1D_MISSES:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_L1D | read_miss;
+                break;
+            case LLC_MISSES:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_LL | read_miss;
+                break;
+            case BRANCH_MISSES:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+                break;
+            default:
+                return -1;
+        }
+
+        int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+        if(fd < 0 && error_.empty()){
+            int err = errno;
+            error_ = std::string(name(e)) + ": perf_event_open failed, " + std::strerror(err);
+            if(err == EACCES || err == EPERM)
+                error_ += " (check /proc/sys/kernel/perf_event_paranoid)";
+            else if(err == ENOENT || err == EOPNOTSUPP)
+                error_ += " (no hardware PMU, e.g. inside a VM)";
+        }
+        return fd;
+#else
+        (void)e;
+        if(error_.empty())
+            error_ = "hardware counters need Linux perf_event_open";
+        return -1;
+#endif
+    }
+};
@@ -0,0 +1,343 @@
+//
+//  Profiler.hpp
+//  cppcommon
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <map>
+#include <algorithm>
+#include <ostream>
+#include <iomanip>
+#include <cstdint>
+#include "TSCClock.hpp"
+
+/**
+    \brief Scoped profiling zones, compiled in with ENABLE_PROFILER
+    \details PROFILE_ZONE("name") times from that line to the end of the enclosing scope,
+    PROFILE_FUNCTION() times the whole function. Without ENABLE_PROFILER defined at compile time both
+    expand to nothing. Zone names must be string literals (or otherwise outlive the profiler).
+*/
+#if defined(ENABLE_PROFILER)
+    #define PROFILE_CONCAT_(a, b) a##b
+    #define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+    #define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+    #define PROFILE_FUNCTION() PROFILE_ZONE(__PRETTY_FUNCTION__)
+#else
+    #define PROFILE_ZONE(name)
+    #define PROFILE_FUNCTION()
+#endif
+
+/**
+    \brief One completed zone, times in TSC ticks
+*/
+struct zoneevent_t{
+    const char *name_;
+    uint64_t start_;
+    uint64_t end_;
+    uint32_t depth_;
+};
+
+/**
+    \brief Aggregated statistics for one zone name, times in nanoseconds
+*/
+struct zonestats_t{
+    std::string name_;
+    size_t count_{0};
+    double inclusive_ns_{0};
+    double exclusive_ns_{0};
+    double p50_ns_{0};
+    double p99_ns_{0};
+    double max_ns_{0};
+};
+
+/**
+    \brief Collects zones recorded by ProfileZone and reports on them
+    \details Each thread records into its own buffer of fixed size chunks. A chunk is only ever
+    written by its thread and publishes its event count with a release store, so recording never
+    takes a lock and report() / exportChromeTrace() can run while other threads are still
+    recording. The only lock is taken once per thread, the first time it records a zone.\n
+    Zones are timed with the TSC (TSCClock.hpp), so recording one costs two counter reads and a
+    store. Each thread holds at most MAX_CHUNKS chunks, zones recorded past that are dropped and
+    counted by dropped(). reset() frees every chunk a thread has finished with, so call it between
+    profiling runs to keep memory down.
+    \date 10-18-26
+*/
+class Profiler{
+public:
+    /**
+        \brief Record a completed zone for the calling thread, used by ProfileZone
+    */
+    static void record(const char *name, uint64_t start, uint64_t end, uint32_t depth){
+        threadbuffer_t &buf = localBuffer();
+        chunk_t *chunk = buf.tail_;
+        size_t n = chunk->count_.load(std::memory_order_relaxed);
+        if(n == CHUNK_EVENTS){
+            if(buf.chunks_.load(std::memory_order_relaxed) >= MAX_CHUNKS){
+                buf.dropped_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            buf.chunks_.fetch_add(1, std::memory_order_relaxed);
+            chunk_t *next = new chunk_t;
+            chunk->next_.store(next, std::memory_order_release);
+            buf.tail_ = chunk = next;
+            n = 0;
+        }
+        chunk->events_[n] = {name, start, end, depth};
+        chunk->count_.store(n + 1, std::memory_order_release);
+    }
+
+    /**
+        \brief Current nesting depth of the calling thread, used by ProfileZone
+    */
+    static uint32_t &depth(){
+        thread_local uint32_t d = 0;
+        return d;
+    }
+
+    /**
+        \brief Ignore every zone that started before now, and free the memory they used
+        \details Each thread's full chunks are freed, the one it's recording into is kept and
+        filtered by start time. Safe to call while other threads are recording
+    */
+    static void reset(){
+        registry_t &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex_);
+        reg.since_.store(TSC::ticks(), std::memory_order_relaxed);
+        for(auto &&buf : reg.buffers_){
+            // A chunk with a next_ is full and its thread has moved on, it's never touched again
+            chunk_t *next;
+            while((next = buf->head_->next_.load(std::memory_order_acquire))){
+                delete buf->head_;
+                buf->head_ = next;
+                buf->chunks_.fetch_sub(1, std::memory_order_relaxed);
+            }
+            buf->dropped_.store(0, std::memory_order_relaxed);
+        }
+    }
+    
+    /**
+        \brief Bytes held by recorded zones, across all threads
+    */
+    static size_t bytes(){
+        registry_t &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex_);
+        size_t chunks = 0;
+        for(auto &&buf : reg.buffers_)
+            chunks += buf->chunks_.load(std::memory_order_relaxed);
+        return chunks * sizeof(chunk_t);
+    }
+    
+    /**
+        \brief Zones not recorded since the last reset because their thread was at MAX_CHUNKS
+    */
+    static size_t dropped(){
+        registry_t &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex_);
+        size_t n = 0;
+        for(auto &&buf : reg.buffers_)
+            n += buf->dropped_.load(std::memory_order_relaxed);
+        return n;
+    }
+
+    /**
+        \brief Aggregate all zones recorded since the last reset, by name
+        \details Exclusive time is inclusive time minus the inclusive time of directly nested zones
+        @return One entry per zone name, sorted by total inclusive time, largest first
+    */
+    static std::vector<zonestats_t> stats(){
+        std::map<std::string, std::vector<double>> durations;
+        std::map<std::string, double> exclusive;
+        for(auto &&events : threadEvents()){
+            // Zones are recorded as they close, so children always come before their parent.
+            // child_ns[d] is the time spent in closed zones at depth d since the last zone at d - 1
+            std::vector<double> child_ns;
+            for(auto &&e : events){
+                double incl = static_cast<double>(TSC::toNs(e.end_) - TSC::toNs(e.start_));
+                if(child_ns.size() < e.depth_ + 2)
+                    child_ns.resize(e.depth_ + 2, 0.0);
+                durations[e.name_].push_back(incl);
+                exclusive[e.name_] += incl - child_ns[e.depth_ + 1];
+                child_ns[e.depth_ + 1] = 0;
+                child_ns[e.depth_] += incl;
+            }
+        }
+
+        std::vector<zonestats_t> all;
+        for(auto &&kv : durations){
+            auto &d = kv.second;
+            std::sort(d.begin(), d.end());
+            zonestats_t z;
+            z.name_ = kv.first;
+            z.count_ = d.size();
+            for(auto v : d)
+                z.inclusive_ns_ += v;
+            z.exclusive_ns_ = exclusive[kv.first];
+            z.p50_ns_ = d[(d.size() - 1) / 2];
+            z.p99_ns_ = d[std::min(d.size() - 1, static_cast<size_t>(0.99 * d.size()))];
+            z.max_ns_ = d.back();
+            all.push_back(std::move(z));
+        }
+        std::sort(all.begin(), all.end(), [](const zonestats_t &a, const zonestats_t &b){
+            return a.inclusive_ns_ > b.inclusive_ns_;
+        });
+        return all;
+    }
+
+    /**
+        \brief Print a table of stats() to out, times in microseconds
+    */
+    static void report(std::ostream &out){
+        auto all = stats();
+        out << std::left << std::setw(40) << "zone" << std::right << std::setw(10) << "calls"
+            << std::setw(14) << "incl us" << std::setw(14) << "excl us" << std::setw(12) << "p50 us"
+            << std::setw(12) << "p99 us" << std::setw(12) << "max us" << '\n';
+        out << std::fixed << std::setprecision(2);
+        for(auto &&z : all){
+            out << std::left << std::setw(40) << z.name_.substr(0, 39) << std::right
+                << std::setw(10) << z.count_ << std::setw(14) << z.inclusive_ns_ / 1000
+                << std::setw(14) << z.exclusive_ns_ / 1000 << std::setw(12) << z.p50_ns_ / 1000
+                << std::setw(12) << z.p99_ns_ / 1000 << std::setw(12) << z.max_ns_ / 1000 << '\n';
+        }
+        out << std::defaultfloat << std::setprecision(6);
+    }
+
+    /**
+        \brief Write every zone as a Chrome trace event file
+        \details Open with chrome://tracing or https://ui.perfetto.dev
+        @param out Stream to write the JSON to
+    */
+    static void exportChromeTrace(std::ostream &out){
+        auto threads = threadEvents();
+        out << "{\"traceEvents\":[";
+        bool first = true;
+        out << std::fixed << std::setprecision(3);
+        for(size_t tid = 0; tid < threads.size(); ++tid){
+            for(auto &&e : threads[tid]){
+                out << (first ? "\n" : ",\n") << "{\"name\":\"";
+                writeEscaped(out, e.name_);
+                out << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+                    << ",\"ts\":" << TSC::toNs(e.start_) / 1000.0
+                    << ",\"dur\":" << (TSC::toNs(e.end_) - TSC::toNs(e.start_)) / 1000.0 << '}';
+                first = false;
+            }
+        }
+        out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+        out << std::defaultfloat << std::setprecision(6);
+    }
+
+    // Events per chunk, and chunks each thread may hold (32 MiB with 32 byte events)
+    static constexpr size_t CHUNK_EVENTS = 4096;
+    static constexpr size_t MAX_CHUNKS = 256;
+
+private:
+
+    struct chunk_t{
+        std::atomic<size_t> count_{0};
+        std::atomic<chunk_t *> next_{nullptr};
+        zoneevent_t events_[CHUNK_EVENTS];
+    };
+
+    struct threadbuffer_t{
+        threadbuffer_t() : head_(new chunk_t), tail_(head_) {}
+        ~threadbuffer_t(){
+            chunk_t *c = head_;
+            while(c){
+                chunk_t *next = c->next_.load(std::memory_order_relaxed);
+                delete c;
+                c = next;
+            }
+        }
+        chunk_t *head_; // under the registry's mutex_
+        chunk_t *tail_; // only touched by the owning thread
+        std::atomic<size_t> chunks_{1};
+        std::atomic<size_t> dropped_{0};
+    };
+
+    struct registry_t{
+        std::mutex mutex_;
+        std::vector<std::unique_ptr<threadbuffer_t>> buffers_;
+        std::atomic<uint64_t> since_{0};
+    };
+
+    // Never destroyed, threads may still record during static destruction
+    static registry_t &registry(){
+        static registry_t *reg = new registry_t;
+        return *reg;
+    }
+
+    // The registry owns the buffer so zones survive the thread exiting
+    static threadbuffer_t &localBuffer(){
+        thread_local threadbuffer_t *buf = nullptr;
+        if(!buf){
+            auto owned = std::unique_ptr<threadbuffer_t>(new threadbuffer_t);
+            buf = owned.get();
+            registry_t &reg = registry();
+            std::lock_guard<std::mutex> lock(reg.mutex_);
+            reg.buffers_.push_back(std::move(owned));
+        }
+        return *buf;
+    }
+
+    // Snapshot of every thread's events since the last reset, in the order they were recorded
+    static std::vector<std::vector<zoneevent_t>> threadEvents(){
+        registry_t &reg = registry();
+        uint64_t since = reg.since_.load(std::memory_order_relaxed);
+        std::vector<std::vector<zoneevent_t>> all;
+        std::lock_guard<std::mutex> lock(reg.mutex_);
+        for(auto &&buf : reg.buffers_){
+            std::vector<zoneevent_t> events;
+            for(chunk_t *c = buf->head_; c; c = c->next_.load(std::memory_order_acquire)){
+                size_t n = c->count_.load(std::memory_order_acquire);
+                for(size_t i = 0; i < n; ++i)
+                    if(c->events_[i].start_ >= since)
+                        events.push_back(c->events_[i]);
+            }
+            all.push_back(std::move(events));
+        }
+        return all;
+    }
+
+    static void writeEscaped(std::ostream &out, const char *s){
+        for(; *s; ++s){
+            if(*s == '"' || *s == '\\')
+                out << '\\' << *s;
+            else if(static_cast<unsigned char>(*s) >= 0x20)
+                out << *s;
+        }
+    }
+};
+
+/**
+    \brief RAII profiling zone, times its own lifetime
+    \details Normally created through PROFILE_ZONE / PROFILE_FUNCTION so it compiles away without
+    ENABLE_PROFILER, but can be used directly.
+    \date 10-18-26
+*/
+class ProfileZone{
+public:
+    explicit ProfileZone(const char *name)
+        : name_(name)
+        , depth_(Profiler::depth()++)
+        , start_(TSC::ticks())
+        {}
+
+    ProfileZone(const ProfileZone &) = delete;
+    ProfileZone &operator=(const ProfileZone &) = delete;
+
+    ~ProfileZone(){
+        uint64_t end = TSC::ticks();
+        --Profiler::depth();
+        Profiler::record(name_, start_, end, depth_);
+    }
+
+private:
+    const char *name_;
+    uint32_t depth_;
+    uint64_t start_;
+};
@@ -0,0 +1,129 @@
+//
+//  SPSCQueue.hpp
+//  cppcommon
+//
+
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+/**
+    \brief Bounded lock-free single producer / single consumer queue
+    \details Fixed capacity ring buffer, exactly one thread may push and exactly one (other) thread
+    may pop. Neither side ever blocks or takes a lock, a push on a full queue or a pop on an empty
+    queue simply returns false. Capacity is rounded up to a power of two.\n
+    The head and tail indices live on separate cache lines so the producer and consumer don't
+    fight over the same line.
+    \date 10-18-26
+*/
+template <class T>
+class SPSCQueue{
+public:
+    /**
+        \brief c'tor
+        @param capacity Maximum number of items held at once, rounded up to a power of two
+    */
+    explicit SPSCQueue(size_t capacity = 1024)
+        : mask_(round_up(capacity) - 1)
+        , slots_(mask_ + 1)
+        {}
+
+    SPSCQueue(const SPSCQueue &) = delete;
+    SPSCQueue &operator=(const SPSCQueue &) = delete;
+
+    /**
+        \brief Producer side push
+        \details item is only moved from when the push succeeds
+        @param item Item to be pushed onto the queue
+        @return True if pushed, false if the queue is full
+    */
+    bool try_push(T &&item){
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if(tail - head_cache_ > mask_){
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if(tail - head_cache_ > mask_)
+                return false;
+        }
+        slots_[tail & mask_] = std::move(item);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+        \brief Producer side push, copies item
+        @param item Item to be pushed onto the queue
+        @return True if pushed, false if the queue is full
+    */
+    bool try_push(const T &item){
+        T cpy(item);
+        return try_push(std::move(cpy));
+    }
+
+    /**
+        \brief Consumer side pop
+        @param item Will be populated with the item at the front of the queue if available
+        @return True if an item was popped, false if the queue is empty
+    */
+    bool try_pop(T &item){
+        size_t head = head_.load(std::memory_order_relaxed);
+        if(head == tail_cache_){
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if(head == tail_cache_)
+                return false;
+        }
+        item = std::move(slots_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+        \brief Check if queue is empty
+        \details Only exact when called from the producer or consumer thread
+        @return True if empty, false otherwise
+    */
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    /**
+        \brief Approximate number of items in the queue
+        @return Number of items in the queue
+    */
+    size_t size() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    /**
+        \brief Maximum number of items the queue can hold
+    */
+    size_t capacity() const { return mask_ + 1; }
+
+private:
+    static const size_t CACHE_LINE = 64;
+
+    static size_t round_up(size_t n){
+        size_t cap = 2;
+        while(cap < n)
+            cap <<= 1;
+        return cap;
+    }
+
+    const size_t mask_;
+    std::vector<T> slots_;
+
+    // Padding rather than alignas, over-aligned new isn't guaranteed before c++17
+    char pad0_[CACHE_LINE];
+
+    // Consumer owned, tail_cache_ saves re-reading the producer's line on every pop
+    std::atomic<size_t> head_{0};
+    size_t tail_cache_{0};
+    char pad1_[CACHE_LINE];
+
+    // Producer owned
+    std::atomic<size_t> tail_{0};
+    size_t head_cache_{0};
+    char pad2_[CACHE_LINE];
+};
@@ -0,0 +1,147 @@
+//
+//  TSCClock.hpp
+//  cppcommon
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+    #include <cpuid.h>
+    #define TSC_CLOCK_X86
+#endif
+
+/**
+    \brief Time stamp counter support shared by TSCClock and TSCPClock
+    \details On first use checks for an invariant TSC (constant rate, doesn't stop in sleep states)
+    and calibrates it against std::chrono::steady_clock for ~20 milliseconds. Without an invariant
+    TSC, or off x86, everything falls back to steady_clock and ticks are nanoseconds.
+    \date 10-18-26
+*/
+class TSC{
+public:
+    /**
+        \brief True if the TSC is invariant and is being used, false if falling back to steady_clock
+    */
+    static bool available() { return calibration().invariant_; }
+
+    /**
+        \brief TSC ticks per nanosecond, 1.0 when falling back to steady_clock
+    */
+    static double ticksPerNs() { return calibration().ticks_per_ns_; }
+
+    /**
+        \brief Raw tick count, rdtsc (not serialized, cheapest)
+    */
+    static uint64_t ticks(){
+#ifdef TSC_CLOCK_X86
+        if(calibration().invariant_)
+            return __rdtsc();
+#endif
+        return steadyNs();
+    }
+
+    /**
+        \brief Raw tick count, rdtscp (waits for earlier instructions to finish)
+    */
+    static uint64_t ticksSerialized(){
+#ifdef TSC_CLOCK_X86
+        if(calibration().invariant_ && calibration().rdtscp_){
+            unsigned aux;
+            return __rdtscp(&aux);
+        }
+#endif
+        return ticks();
+    }
+
+    /**
+        \brief Convert a tick count to nanoseconds on the steady_clock timeline
+    */
+    static int64_t toNs(uint64_t ticks){
+        const auto &cal = calibration();
+        if(!cal.invariant_)
+            return static_cast<int64_t>(ticks);
+        // Relative to the calibration point so the double keeps nanosecond precision
+        double delta = static_cast<double>(static_cast<int64_t>(ticks - cal.base_ticks_));
+        return cal.base_ns_ + static_cast<int64_t>(delta / cal.ticks_per_ns_);
+    }
+
+private:
+    struct calibration_t{
+        bool invariant_{false};
+        bool rdtscp_{false};
+        double ticks_per_ns_{1.0};
+        uint64_t base_ticks_{0};
+        int64_t base_ns_{0};
+    };
+
+    static int64_t steadyNs(){
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Thread safe, runs once on first use
+    static const calibration_t &calibration(){
+        static const calibration_t cal = calibrate();
+        return cal;
+    }
+
+    static calibration_t calibrate(){
+        calibration_t cal;
+#ifdef TSC_CLOCK_X86
+        unsigned eax, ebx, ecx, edx;
+        if(__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 || eax < 0x80000007)
+            return cal;
+        // CPUID.80000001H:EDX[27] rdtscp, CPUID.80000007H:EDX[8] invariant TSC
+        if(__get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx))
+            cal.rdtscp_ = (edx >> 27) & 1;
+        if(!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !((edx >> 8) & 1))
+            return cal;
+
+        int64_t ns_start = steadyNs();
+        uint64_t tsc_start = __rdtsc();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        int64_t ns_end = steadyNs();
+        uint64_t tsc_end = __rdtsc();
+        if(ns_end <= ns_start || tsc_end <= tsc_start)
+            return cal;
+
+        cal.ticks_per_ns_ = static_cast<double>(tsc_end - tsc_start) / static_cast<double>(ns_end - ns_start);
+        cal.base_ticks_ = tsc_end;
+        cal.base_ns_ = ns_end;
+        cal.invariant_ = true;
+#endif
+        return cal;
+    }
+};
+
+/**
+    \brief std::chrono compatible clock backed by the time stamp counter
+    \details Meets the Clock requirements so it can be used anywhere steady_clock can, including as
+    the Timer clock policy (see TSCTimer). Serialized = true uses rdtscp instead of rdtsc, slightly
+    slower but instructions before the read can't be reordered past it. Falls back to steady_clock
+    when there is no invariant TSC.
+    \date 10-18-26
+*/
+template <bool Serialized>
+class BasicTSCClock{
+public:
+    using rep = int64_t;
+    using period = std::nano;
+    using duration = std::chrono::nanoseconds;
+    using time_point = std::chrono::time_point<BasicTSCClock>;
+    static constexpr bool is_steady = true;
+
+    static time_point now() noexcept {
+        return time_point(duration(TSC::toNs(Serialized ? TSC::ticksSerialized() : TSC::ticks())));
+    }
+};
+
+template <bool Serialized>
+constexpr bool BasicTSCClock<Serialized>::is_steady;
+
+using TSCClock = BasicTSCClock<false>;
+using TSCPClock = BasicTSCClock<true>;
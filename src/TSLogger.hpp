@@ -23,7 +23,107 @@
 #include <iomanip>
 #include <cstdlib>
 #include <thread>
+#include <atomic>
+#include <vector>
+#include <cmath>
+#include <type_traits>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <charconv>
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
 #include "TSQueue.hpp"
+#include "SPSCQueue.hpp"
+#include "LogRing.hpp"
+#include "TimeStamp.hpp"
+
+class MetricsRegistry;
+
+/**
+    \brief Single key / value pair attached to a structured log message
+    \details quote_ is false for numbers and bools so they are written as JSON numbers / literals
+*/
+struct logfield_t{
+    std::string key_;
+    std::string value_;
+    bool quote_;
+};
+
+/**
+    \brief Key / value fields for structured log messages
+    \details Built on the calling thread, rendered by the logger thread. e.g. \n
+    logger.info("request done", LogFields().add("user", id).add("latency_us", us), FUNC);
+    \date 10-18-26
+*/
+class LogFields{
+public:
+    /**
+        \brief Add a field
+        \details Arithmetic values are written unquoted, everything else is written as a string
+        @param key The field name
+        @param value The field value, anything that can be written to a std::ostream
+        @return *this, so calls can be chained
+    */
+    template <class VAL_T>
+    LogFields &add(const std::string &key, const VAL_T &value){
+        fields_.push_back(make_field(key, value, std::is_arithmetic<VAL_T>()));
+        return *this;
+    }
+    
+    LogFields &add(const std::string &key, const std::string &value){
+        fields_.push_back({key, value, true});
+        return *this;
+    }
+    
+    LogFields &add(const std::string &key, const char *value){
+        fields_.push_back({key, value, true});
+        return *this;
+    }
+    
+    LogFields &add(const std::string &key, char value){
+        fields_.push_back({key, std::string(1, value), true});
+        return *this;
+    }
+    
+    LogFields &add(const std::string &key, bool value){
+        fields_.push_back({key, value ? "true" : "false", false});
+        return *this;
+    }
+    
+    const std::vector<logfield_t> &fields() const { return fields_; }
+    
+private:
+    std::vector<logfield_t> fields_;
+    
+    // Shortest text that reads back as the same value, 1.5 stays "1.5" and 1e-09 isn't "0.000000"
+    template <class VAL_T>
+    static logfield_t make_field(const std::string &key, const VAL_T &value, std::true_type){
+        char buf[64];
+        auto res = std::to_chars(buf, buf + sizeof(buf), value);
+        std::string text(buf, res.ptr);
+        // NaN and inf aren't valid JSON numbers
+        if(!std::isfinite(static_cast<double>(value)))
+            return {key, text, true};
+        return {key, text, false};
+    }
+    
+    template <class VAL_T>
+    static logfield_t make_field(const std::string &key, const VAL_T &value, std::false_type){
+        std::stringstream ss;
+        ss << value;
+        return {key, ss.str(), true};
+    }
+};
+
+/**
+    \brief Output format of each log line, see TSLogger::setFormat
+*/
+enum class LogFormat{ TEXT, JSON, LOGFMT };
 
 /**
     \brief Log message type used by the logger
@@ -38,10 +138,28 @@ struct logmessage_t{
         , function_name_(function_name)
         , log_message_type_(type)
         {}
+    logmessage_t(const std::string& message_to_be_logged, const std::string &function_name,
+               const std::string &type, const std::vector<logfield_t> &fields)
+        : message_to_be_logged_(message_to_be_logged)
+        , function_name_(function_name)
+        , log_message_type_(type)
+        , fields_(fields)
+        {}
     
     std::string message_to_be_logged_;
     std::string function_name_;
     std::string log_message_type_;
+    std::vector<logfield_t> fields_;
+    // When the message was logged (steady_clock nanoseconds) and its number on the logging thread,
+    // used to merge the per-thread queues back into logged order
+    int64_t time_ns_{0};
+    uint64_t seq_{0};
+    // Rate limiting slot of the message's call site, NO_SITE when rate limiting is off
+    size_t site_{NO_SITE};
+    // Format set when the message was logged, the line is rendered later on the logger thread
+    LogFormat format_{LogFormat::TEXT};
+    
+    static const size_t NO_SITE = static_cast<size_t>(-1);
 };
 
 /**
@@ -51,13 +169,38 @@ struct logmessage_t{
     buffered (outside of the queue), messages are written one at a time in an attempt to have 
     complete logs if the event of an unhandled exception. Buffering may be implmented in the future.
     \n
+    Each thread that logs gets its own lock-free SPSCQueue, so logging threads never contend with
+    each other. The background thread sweeps all of them and writes the messages in the order they
+    were logged, holding a message back until no thread can still queue an older one. If a thread's
+    queue fills up its messages fall back to the shared TSQueue.
+    \n
+    To survive log storms, setRateLimit limits how often each call site can log (extra messages are
+    dropped before they're queued, and the number dropped is reported once per second) and
+    setCollapseDuplicates replaces runs of identical messages with "last message repeated N times".
+    \n
+    enableFlightRecorder additionally copies every message into a memory mapped LogRing as it is
+    logged, so the most recent messages survive kill() or the process crashing before the
+    background thread wrote them.
+    \n
     FUNC is a defined macro that can be (optionally) passed to all logging functions to display the
     calling function name in the log message.
+    \n
+    Every logging function has an overload taking LogFields for structured logging. Lines are
+    written as plain text by default, setFormat switches to newline delimited JSON or logfmt.
     \author Sean Grimes, spg63@cs.drexel.edu
     \date 12-28-16
 */
 class TSLogger{
 public:
+    /**
+        \brief Output format of each log line
+        \details
+        - TEXT - time TYPE: func: msg key=value ... (default) \n
+        - JSON - {"time":"...","level":"TYPE","func":"...","msg":"...","key":value,...} \n
+        - LOGFMT - time="..." level=TYPE func="..." msg="..." key=value ...
+    */
+    using Format = LogFormat;
+    
     /**
         \brief default c'tor
         \details By default logs are written to "log.txt" in the CWD, and the backing queue using a
@@ -79,8 +222,22 @@ public:
         @param queue_cond_var_timeout Timeout for backing queue, std::chrono::milliseconds
     */
     TSLogger(std::string logFile, std::chrono::milliseconds queue_cond_var_timeout)
+        : TSLogger(logFile, queue_cond_var_timeout, TimeStamp()) {}
+    
+    /**
+        \brief Custom time stamp c'tor
+        \details Set log file, backing queue timeout, and how time stamps are rendered (local / UTC /
+        monotonic, milliseconds / microseconds)
+        @param logFile The log file
+        @param queue_cond_var_timeout Timeout for backing queue, std::chrono::milliseconds
+        @param stamp TimeStamp used to render the time of each message
+    */
+    TSLogger(std::string logFile, std::chrono::milliseconds queue_cond_var_timeout, TimeStamp stamp)
         : logFile_(logFile)
         , timeout_(queue_cond_var_timeout)
+        , stamp_(stamp)
+        , id_(next_id())
+        , rate_slots_(new rate_slot_t[RATE_SLOTS])
         {
             consumer_ = std::thread(&TSLogger::pop_and_write, this);
         }
@@ -92,6 +249,7 @@ public:
     
     ~TSLogger(){
         stop_logging_ = true;
+        wake_consumer();
         if(consumer_.joinable())
             consumer_.join();
 #ifdef PRINT_LIB_ERRORS
@@ -108,12 +266,87 @@ public:
         out << "" << std::flush;
     }
     
+    /**
+        \brief Set the output format for all following messages
+        \details Messages already logged keep the format they were logged with
+        @param format TEXT, JSON, or LOGFMT
+    */
+    void setFormat(Format format){
+        format_ = format;
+    }
+    
+    /**
+        \brief Limit how often each call site can log
+        \details Token bucket per call site, a call site being the message type plus the function
+        name passed in (or the message itself when no function name is passed). Messages over the
+        limit are dropped on the calling thread, the number dropped per call site is written to the
+        log once per second. Call sites are hashed into a fixed table, so distinct call sites can
+        occasionally share a bucket.
+        @param per_second Sustained messages per second allowed per call site, 0 disables the limit
+        @param burst Number of messages allowed at once before the limit kicks in
+    */
+    void setRateLimit(double per_second, size_t burst = 10){
+        if(per_second <= 0){
+            rate_interval_ns_ = 0;
+            return;
+        }
+        int64_t interval = static_cast<int64_t>(1000000000.0 / per_second);
+        if(interval < 1)
+            interval = 1;
+        rate_tolerance_ns_ = interval * static_cast<int64_t>(burst ? burst - 1 : 0);
+        rate_interval_ns_ = interval;
+    }
+    
+    /**
+        \brief Collapse runs of identical messages
+        \details When enabled, a message identical to the previous one (type, function, message,
+        and fields) isn't written. Instead a single "last message repeated N times" line is written
+        when a different message arrives, once per second while the repeats continue, and on
+        shutdown.
+        @param collapse True to collapse duplicates, false (default) to write every message
+    */
+    void setCollapseDuplicates(bool collapse){
+        collapse_ = collapse;
+    }
+    
+    /**
+        \brief Also record every message in a crash-safe memory mapped ring file
+        \details Messages are copied into the ring on the logging thread, before they're queued, so
+        they survive the process dying. No fsync is done. Read the ring back with LogRing::dump or
+        the LogRing example. Call this before other threads start logging, calling it again has no
+        effect.
+        @param ring_file Path to the ring file, created if it doesn't exist
+        @param slots Number of messages the ring holds before the oldest are overwritten
+        @param slot_size Bytes per message, longer messages are truncated
+        @throws std::runtime_error if the ring file can't be created or mapped
+    */
+    void enableFlightRecorder(const std::string &ring_file, size_t slots = 4096,
+                              size_t slot_size = 256){
+        if(ring_)
+            return;
+        ring_owner_.reset(new LogRing(ring_file, slots, slot_size));
+        ring_ = ring_owner_.get();
+    }
+    
+    /**
+        \brief Publish logger activity to a metrics registry
+        \details Adds <prefix>_messages_total (accepted), <prefix>_rate_limited_total (dropped by
+        setRateLimit), <prefix>_overflow_total (per-thread queue was full), and
+        <prefix>_lines_written_total. Call this before other threads start logging, calling it again
+        has no effect. Defined in Metrics.hpp, include it to call this.
+        @param registry Registry to publish to, must outlive the logger
+        @param prefix Metric name prefix, must be a valid Prometheus name
+    */
+    void publishMetrics(MetricsRegistry &registry, const std::string &prefix = "tslogger");
+    
     /**
         \brief Immediately kill logger
-        \details Unwritten log messages will be lost
+        \details Unwritten log messages will be lost, unless the flight recorder is enabled in
+        which case they are still in the ring file
     */
     void kill(){
         kill_ = true;
+        wake_consumer();
     }
     
     /**
@@ -127,6 +360,17 @@ public:
         form_and_push(msg, func_name, "INFO");
     }
     
+    /**
+        \brief info messages with structured fields
+        @param msg The log message
+        @param fields Key / value pairs written alongside the message
+        @param func_name Optional - name of function where message was logged from
+    */
+    template <class MSG_T>
+    void info(const MSG_T &msg, const LogFields &fields, const std::string &func_name = ""){
+        form_and_push(msg, func_name, "INFO", fields.fields());
+    }
+    
     /**
         \brief debug messages
         @param msg The log message
@@ -138,6 +382,17 @@ public:
         form_and_push(msg, func_name, "DEBUG");
     }
     
+    /**
+        \brief debug messages with structured fields
+        @param msg The log message
+        @param fields Key / value pairs written alongside the message
+        @param func_name Optional - name of function where message was logged from
+    */
+    template <class MSG_T>
+    void debug(const MSG_T &msg, const LogFields &fields, const std::string &func_name = ""){
+        form_and_push(msg, func_name, "DEBUG", fields.fields());
+    }
+    
     /**
         \brief warning messages
         @param msg The log message
@@ -148,6 +403,17 @@ public:
     void warn(const MSG_T &msg, const std::string &func_name = ""){
         form_and_push(msg, func_name, "WARNING");
     }
+    
+    /**
+        \brief warning messages with structured fields
+        @param msg The log message
+        @param fields Key / value pairs written alongside the message
+        @param func_name Optional - name of function where message was logged from
+    */
+    template <class MSG_T>
+    void warn(const MSG_T &msg, const LogFields &fields, const std::string &func_name = ""){
+        form_and_push(msg, func_name, "WARNING", fields.fields());
+    }
     /**
         \brief error messages
         @param msg The log message
@@ -158,6 +424,17 @@ public:
     void error(const MSG_T &msg, const std::string &func_name = ""){
         form_and_push(msg, func_name, "ERROR");
     }
+    
+    /**
+        \brief error messages with structured fields
+        @param msg The log message
+        @param fields Key / value pairs written alongside the message
+        @param func_name Optional - name of function where message was logged from
+    */
+    template <class MSG_T>
+    void error(const MSG_T &msg, const LogFields &fields, const std::string &func_name = ""){
+        form_and_push(msg, func_name, "ERROR", fields.fields());
+    }
    
     /**
         \brief fatal messages
@@ -170,56 +447,287 @@ public:
         form_and_push(msg, func_name, "FATAL");
     }
     
+    /**
+        \brief fatal messages with structured fields
+        @param msg The log message
+        @param fields Key / value pairs written alongside the message
+        @param func_name Optional - name of function where message was logged from
+    */
+    template <class MSG_T>
+    void fatal(const MSG_T &msg, const LogFields &fields, const std::string &func_name = ""){
+        form_and_push(msg, func_name, "FATAL", fields.fields());
+    }
+    
     
 private:
     std::string logFile_;
     TSQueue<logmessage_t> msg_queue_;
-    volatile bool stop_logging_{false};
-    volatile bool kill_{false};
+    std::atomic<bool> stop_logging_{false};
+    std::atomic<bool> kill_{false};
     std::thread consumer_;
     std::chrono::milliseconds timeout_{10};
+    std::atomic<Format> format_{Format::TEXT};
     
-    std::string timeStamp(){
-        auto now = std::chrono::system_clock::now();
-        auto count = std::chrono::system_clock::to_time_t(now);
-        auto secs = std::chrono::time_point_cast<std::chrono::seconds>(now);
-        auto partial = now - secs;
-        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(partial);
+    // Only used by the consumer thread, TimeStamp caches the date / second prefix
+    TimeStamp stamp_;
+    
+    // Per-thread staging queues, owned by the logger so they go with it. rings_mutex_ is only
+    // taken when a thread logs for the first time and by the consumer while it sweeps, never on the
+    // normal logging path
+    struct ring_t{
+        explicit ring_t(size_t capacity) : queue_(capacity), floor_ns_(now_ns()) {}
+        SPSCQueue<logmessage_t> queue_;
+        // Set when the logging thread exits, the queue is dropped once it's drained
+        std::atomic<bool> producer_gone_{false};
+        // Set while the thread is between stamping a message and queueing it, see sweep
+        std::atomic<bool> busy_{false};
+        // Logging thread only, numbers its messages
+        uint64_t next_seq_{0};
+        // Consumer only, nothing this thread hasn't queued yet was stamped before it
+        int64_t floor_ns_;
+    };
+    static const size_t RING_CAPACITY = 1024;
+    const uint64_t id_;
+    std::mutex rings_mutex_;
+    std::vector<std::shared_ptr<ring_t>> rings_;
+    
+    // Each thread's view of its queues, one per logger it has used. ring_ is only dereferenced
+    // through a live logger, the weak_ptr lets the thread tell a live logger's queue it has exited
+    struct local_rings_t{
+        struct entry_t{
+            ring_t *ring_;
+            std::weak_ptr<ring_t> weak_;
+        };
+        std::unordered_map<uint64_t, entry_t> rings_;
         
-        std::stringstream ss;
-        ss << std::put_time(std::localtime(&count), "%Y-%m-%d %X");
-        ss << "." << ms.count();
-        return ss.str();
+        ~local_rings_t(){
+            for(auto &entry : rings_)
+                if(auto ring = entry.second.weak_.lock())
+                    ring->producer_gone_.store(true, std::memory_order_release);
+        }
+    };
+    
+    // The consumer sleeps on wake_cv_ when every queue is empty, producers only take wake_mutex_
+    // when sleeping_ says it's asleep
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    std::atomic<bool> sleeping_{false};
+    // How long the consumer sleeps when it's only waiting to write messages it held back
+    static constexpr std::chrono::milliseconds HOLD_WAIT{1};
+    
+    // Rate limiting, one GCRA (token bucket equivalent) slot per hashed call site. tat_ is the
+    // theoretical arrival time of the next message in steady_clock nanoseconds
+    struct rate_slot_t{
+        std::atomic<int64_t> tat_{0};
+        std::atomic<uint64_t> suppressed_{0};
+    };
+    static const size_t RATE_SLOTS = 1024;
+    std::atomic<int64_t> rate_interval_ns_{0};
+    std::atomic<int64_t> rate_tolerance_ns_{0};
+    std::unique_ptr<rate_slot_t[]> rate_slots_;
+    
+    // Duplicate collapsing and suppression reports, everything but collapse_ is consumer only
+    std::atomic<bool> collapse_{false};
+    logmessage_t last_msg_;
+    bool have_last_{false};
+    uint64_t repeats_{0};
+    std::vector<std::string> site_labels_;
+    std::chrono::steady_clock::time_point last_report_{std::chrono::steady_clock::now()};
+    
+    // Flight recorder, written by the logging threads
+    std::unique_ptr<LogRing> ring_owner_;
+    std::atomic<LogRing *> ring_{nullptr};
+    
+    // Optional metrics, what publishMetrics hooks in. Abstract so this header doesn't need
+    // Metrics.hpp
+    struct metrics_t{
+        virtual ~metrics_t() = default;
+        virtual void accepted() = 0;
+        virtual void rateLimited() = 0;
+        virtual void overflowed() = 0;
+        virtual void written() = 0;
+    };
+    std::unique_ptr<metrics_t> metrics_owner_;
+    std::atomic<metrics_t *> metrics_{nullptr};
+    
+    void count(void (metrics_t::*which)()){
+        metrics_t *m = metrics_.load(std::memory_order_acquire);
+        if(m)
+            (m->*which)();
+    }
+    
+    void record(const logmessage_t &msg){
+        thread_local std::string text;
+        text.clear();
+        if(!msg.function_name_.empty()){
+            text += msg.function_name_;
+            text += ": ";
+        }
+        text += msg.message_to_be_logged_;
+        append_logfmt_fields(text, msg.fields_);
+        ring_.load(std::memory_order_acquire)->write(msg.log_message_type_, text);
+    }
+    
+    // Thread local queues are keyed on this rather than 'this' so a new logger constructed at the
+    // address of a destroyed one can't pick up the old queue
+    static uint64_t next_id(){
+        static std::atomic<uint64_t> id{0};
+        return id++;
+    }
+    
+    ring_t &local_ring(){
+        thread_local local_rings_t local;
+        auto it = local.rings_.find(id_);
+        if(it != local.rings_.end())
+            return *it->second.ring_;
+        
+        // Forget the queues of loggers that are gone, the logger freed them
+        for(auto stale = local.rings_.begin(); stale != local.rings_.end();){
+            if(stale->second.weak_.expired())
+                stale = local.rings_.erase(stale);
+            else
+                ++stale;
+        }
+        auto ring = std::make_shared<ring_t>(size_t{RING_CAPACITY});
+        {
+            std::lock_guard<std::mutex> lock(rings_mutex_);
+            rings_.push_back(ring);
+        }
+        local.rings_.emplace(id_, local_rings_t::entry_t{ring.get(), ring});
+        return *ring;
+    }
+    
+    // Called after queueing a message. The fence pairs with the one in pop_and_write, either the
+    // consumer's last sweep sees the message or this sees sleeping_ and wakes it
+    void wake_if_sleeping(){
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(sleeping_.load(std::memory_order_relaxed))
+            wake_consumer();
+    }
+    
+    void wake_consumer(){
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        wake_cv_.notify_one();
+    }
+    
+    static int64_t now_ns(){
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    
+    // Pull everything currently available from the shared queue and the per-thread queues. Returns
+    // the watermark, every message stamped before it is now in batch or was in an earlier one. A
+    // thread in the middle of logging holds the watermark back to the last sweep that saw it idle,
+    // the fence pairs with the one in form_and_push: either busy_ is seen here or the message is
+    // stamped after mark
+    int64_t sweep(std::vector<logmessage_t> &batch){
+        int64_t mark = now_ns();
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        int64_t watermark = mark;
+        for(auto &ring : rings_){
+            if(ring->busy_.load(std::memory_order_acquire))
+                watermark = std::min(watermark, ring->floor_ns_);
+            else
+                ring->floor_ns_ = mark;
+        }
+        
+        logmessage_t msg;
+        while(msg_queue_.try_and_pop(msg))
+            batch.push_back(std::move(msg));
+        for(auto it = rings_.begin(); it != rings_.end();){
+            ring_t &ring = **it;
+            // Read first, everything the thread logged is in the queue once it's set
+            bool gone = ring.producer_gone_.load(std::memory_order_acquire);
+            // Bounded so one busy thread can't starve the rest
+            size_t popped = 0;
+            for(; popped < RING_CAPACITY && ring.queue_.try_pop(msg); ++popped)
+                batch.push_back(std::move(msg));
+            // What's left is no older than the last message taken
+            if(popped == RING_CAPACITY && !ring.queue_.empty())
+                watermark = std::min(watermark, batch.back().time_ns_);
+            
+            if(gone && ring.queue_.empty())
+                it = rings_.erase(it);
+            else
+                ++it;
+        }
+        return watermark;
     }
     
     void pop_and_write(){
-        // Main loop for the logger thread, will check queue for messages and write them
+        // Reused for every batch so the buffers only allocate when they need to grow
+        std::string line;
+        std::vector<logmessage_t> batch;
+        // Swept but not yet written, in logged order. Anything at or past the watermark waits for a
+        // later sweep in case an older message is still on its way
+        std::vector<logmessage_t> pending;
+        auto logged_before = [](const logmessage_t &a, const logmessage_t &b){
+            return a.time_ns_ < b.time_ns_ || (a.time_ns_ == b.time_ns_ && a.seq_ < b.seq_);
+        };
+        
+        // Main loop for the logger thread, will check queues for messages and write them
         while(true){
+            // Read before sweeping, anything logged before the d'tor ran is then in this sweep
+            bool stopping = stop_logging_;
+            batch.clear();
+            int64_t watermark = sweep(batch);
+            
+            // Nothing staged, sleep until a producer wakes us instead of spinning. Wakes after
+            // timeout_ regardless so the once a second reports still go out
+            if(batch.empty() && !stopping && !kill_){
+                std::unique_lock<std::mutex> lock(wake_mutex_);
+                sleeping_.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                watermark = sweep(batch);
+                // Held back messages only need another sweep
+                auto wait = pending.empty() ? timeout_ : std::min(timeout_, HOLD_WAIT);
+                if(batch.empty() && !stop_logging_ && !kill_)
+                    wake_cv_.wait_for(lock, wait);
+                sleeping_.store(false, std::memory_order_relaxed);
+                lock.unlock();
+                watermark = sweep(batch);
+            }
             
+            // Repeat counts and dropped message counts are written once per second
+            auto now = std::chrono::steady_clock::now();
+            bool report_due = now - last_report_ >= std::chrono::seconds(1);
+            bool done = stopping && batch.empty();
             
-            // Use try_and_pop instead of wait_and_pop so the thread can be immediately killed
-            // if necessary; wait_and_pop will block on the thread while the queue is empty
-            logmessage_t msg;
-            bool did_receive_message = msg_queue_.try_and_pop(msg, timeout_);
+            // Merge the received messages into the held back ones, in logged order, and write
+            // everything before the watermark to the log file. All of it goes on shutdown
+            std::sort(batch.begin(), batch.end(), logged_before);
+            size_t held = pending.size();
+            pending.insert(pending.end(), std::make_move_iterator(batch.begin()),
+                           std::make_move_iterator(batch.end()));
+            std::inplace_merge(pending.begin(), pending.begin() + static_cast<std::ptrdiff_t>(held),
+                               pending.end(), logged_before);
+            auto ready = done ? pending.end()
+                              : std::partition_point(pending.begin(), pending.end(),
+                                                     [watermark](const logmessage_t &msg){
+                                                         return msg.time_ns_ < watermark;
+                                                     });
             
-            // Process the received message and write it to the log file
-            if(did_receive_message){
-                std::string time_str = timeStamp();
-                std::string fnamestr = "";
-                if(msg.function_name_ != "")
-                    fnamestr = msg.function_name_;
-                if(fnamestr != "")
-                    fnamestr += ": ";
-                
-                std::stringstream ss;
-                ss << time_str << " " << msg.log_message_type_ << ": " << fnamestr;
-                ss << msg.message_to_be_logged_ << '\n';
+            // Pending repeats and drop counts are also flushed on shutdown
+            bool summaries = repeats_ || rate_interval_ns_;
+            if(ready != pending.begin() || ((report_due || done) && summaries)){
                 std::ofstream out(logFile_, std::ios::out | std::ios::app);
-                out << ss.str() << std::flush;
+                for(auto it = pending.begin(); it != ready; ++it){
+                    if(kill_)
+                        break;
+                    write_or_collapse(out, line, *it);
+                }
+                if(report_due || done){
+                    flush_repeats(out, line);
+                    report_suppressed(out, line);
+                }
             }
+            pending.erase(pending.begin(), ready);
+            if(report_due)
+                last_report_ = now;
             
-            // stop_logging_ set to true in d'tor, keep pulling messages until queue is empty
-            if(stop_logging_ && msg_queue_.empty())
+            // stop_logging_ set to true in d'tor, keep pulling messages until all queues are empty
+            if(done)
                 break;
             
             // kill_ allows for immediate thread death regardless of messages already in queue
@@ -228,8 +736,247 @@ private:
         }
     }
     
+    void write_line(std::ofstream &out, std::string &line, const logmessage_t &msg){
+        line.clear();
+        render(line, msg);
+        out.write(line.data(), static_cast<std::streamsize>(line.size()));
+        out.flush();
+        count(&metrics_t::written);
+    }
+    
+    static bool same_message(const logmessage_t &a, const logmessage_t &b){
+        if(a.message_to_be_logged_ != b.message_to_be_logged_
+           || a.function_name_ != b.function_name_
+           || a.log_message_type_ != b.log_message_type_
+           || a.fields_.size() != b.fields_.size())
+            return false;
+        for(size_t i = 0; i < a.fields_.size(); ++i)
+            if(a.fields_[i].key_ != b.fields_[i].key_ || a.fields_[i].value_ != b.fields_[i].value_)
+                return false;
+        return true;
+    }
+    
+    void write_or_collapse(std::ofstream &out, std::string &line, logmessage_t &msg){
+        if(msg.site_ != logmessage_t::NO_SITE){
+            if(site_labels_.empty())
+                site_labels_.resize(RATE_SLOTS);
+            if(site_labels_[msg.site_].empty())
+                site_labels_[msg.site_] = msg.log_message_type_ + ": "
+                    + (msg.function_name_.empty() ? msg.message_to_be_logged_ : msg.function_name_);
+        }
+        
+        if(!collapse_){
+            write_line(out, line, msg);
+            return;
+        }
+        if(have_last_ && same_message(last_msg_, msg)){
+            ++repeats_;
+            return;
+        }
+        flush_repeats(out, line);
+        write_line(out, line, msg);
+        last_msg_ = std::move(msg);
+        have_last_ = true;
+    }
+    
+    void flush_repeats(std::ofstream &out, std::string &line){
+        if(!repeats_)
+            return;
+        logmessage_t msg("last message repeated " + std::to_string(repeats_) + " times",
+                         last_msg_.function_name_, last_msg_.log_message_type_);
+        msg.format_ = last_msg_.format_;
+        write_line(out, line, msg);
+        repeats_ = 0;
+    }
+    
+    void report_suppressed(std::ofstream &out, std::string &line){
+        for(size_t i = 0; i < RATE_SLOTS; ++i){
+            uint64_t dropped = rate_slots_[i].suppressed_.exchange(0, std::memory_order_relaxed);
+            if(!dropped)
+                continue;
+            std::string site = site_labels_.empty() || site_labels_[i].empty()
+                ? "call site " + std::to_string(i) : site_labels_[i];
+            logmessage_t msg("rate limit dropped " + std::to_string(dropped) + " messages from "
+                             + site, "", "WARNING");
+            msg.format_ = format_.load(std::memory_order_relaxed);
+            write_line(out, line, msg);
+        }
+    }
+    
+    // Call site is the type plus the function name, or the message when there's no function name
+    static size_t site_of(const std::string &type, const std::string &key){
+        size_t h = std::hash<std::string>()(type);
+        h ^= std::hash<std::string>()(key) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+        return h % RATE_SLOTS;
+    }
+    
+    // Lock-free GCRA check, allowed while now is within rate_tolerance_ns_ of the slot's
+    // theoretical arrival time, each allowed message pushes that time forward one interval
+    bool rate_allowed(size_t site){
+        int64_t interval = rate_interval_ns_.load(std::memory_order_relaxed);
+        if(!interval)
+            return true;
+        int64_t tolerance = rate_tolerance_ns_.load(std::memory_order_relaxed);
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now().time_since_epoch()).count();
+        
+        rate_slot_t &slot = rate_slots_[site];
+        int64_t tat = slot.tat_.load(std::memory_order_relaxed);
+        while(true){
+            if(now < tat - tolerance){
+                slot.suppressed_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            int64_t next = std::max(tat, now) + interval;
+            if(slot.tat_.compare_exchange_weak(tat, next, std::memory_order_relaxed))
+                return true;
+        }
+    }
+    
+    void render(std::string &line, const logmessage_t &msg){
+        char time_buf[TimeStamp::MAX_LEN];
+        size_t time_len = stamp_.writeNow(time_buf);
+        
+        switch(msg.format_){
+            case Format::JSON:
+                line += "{\"time\":\"";
+                line.append(time_buf, time_len);
+                line += "\",\"level\":\"";
+                append_escaped(line, msg.log_message_type_);
+                line += '"';
+                if(!msg.function_name_.empty()){
+                    line += ",\"func\":\"";
+                    append_escaped(line, msg.function_name_);
+                    line += '"';
+                }
+                line += ",\"msg\":\"";
+                append_escaped(line, msg.message_to_be_logged_);
+                line += '"';
+                for(auto &&field : msg.fields_){
+                    line += ",\"";
+                    append_escaped(line, field.key_);
+                    line += "\":";
+                    if(field.quote_) line += '"';
+                    append_escaped(line, field.value_);
+                    if(field.quote_) line += '"';
+                }
+                line += "}\n";
+                break;
+            case Format::LOGFMT:
+                line += "time=\"";
+                line.append(time_buf, time_len);
+                line += "\" level=";
+                append_logfmt_value(line, msg.log_message_type_);
+                if(!msg.function_name_.empty()){
+                    line += " func=";
+                    append_logfmt_value(line, msg.function_name_);
+                }
+                line += " msg=";
+                append_logfmt_value(line, msg.message_to_be_logged_);
+                append_logfmt_fields(line, msg.fields_);
+                line += '\n';
+                break;
+            case Format::TEXT:
+            default:
+                line.append(time_buf, time_len);
+                line += ' ';
+                line += msg.log_message_type_;
+                line += ": ";
+                if(!msg.function_name_.empty()){
+                    line += msg.function_name_;
+                    line += ": ";
+                }
+                line += msg.message_to_be_logged_;
+                append_logfmt_fields(line, msg.fields_);
+                line += '\n';
+                break;
+        }
+    }
+    
+    static void append_logfmt_fields(std::string &line, const std::vector<logfield_t> &fields){
+        for(auto &&field : fields){
+            line += ' ';
+            line += field.key_;
+            line += '=';
+            append_logfmt_value(line, field.value_);
+        }
+    }
+    
+    // logfmt values only need quotes when they contain spaces, quotes, '=' or need escaping
+    static void append_logfmt_value(std::string &line, const std::string &value){
+        bool plain = !value.empty() && next_to_escape(value.data(), value.data() + value.size())
+                                       == value.data() + value.size();
+        for(size_t i = 0; plain && i < value.size(); ++i)
+            if(value[i] == ' ' || value[i] == '=')
+                plain = false;
+        if(plain){
+            line += value;
+            return;
+        }
+        line += '"';
+        append_escaped(line, value);
+        line += '"';
+    }
+    
+    static bool needs_escape(char ch){
+        return ch == '"' || ch == '\\' || static_cast<unsigned char>(ch) < 0x20;
+    }
+    
+    // Find the next character that needs escaping, 16 bytes at a time when SSE2 is available
+    static const char *next_to_escape(const char *p, const char *end){
+#ifdef __SSE2__
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i control = _mm_set1_epi8(0x1F);
+        while(end - p >= 16){
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            // unsigned chunk <= 0x1F is the same as min(chunk, 0x1F) == chunk
+            __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                                                     _mm_cmpeq_epi8(chunk, backslash)),
+                                        _mm_cmpeq_epi8(_mm_min_epu8(chunk, control), chunk));
+            int mask = _mm_movemask_epi8(hits);
+            if(mask)
+                return p + __builtin_ctz(static_cast<unsigned>(mask));
+            p += 16;
+        }
+#endif
+        for(; p < end; ++p)
+            if(needs_escape(*p))
+                return p;
+        return end;
+    }
+    
+    // JSON string escaping, runs of clean characters are appended in one call
+    static void append_escaped(std::string &line, const std::string &str){
+        static const char HEX[] = "0123456789abcdef";
+        const char *p = str.data();
+        const char *end = p + str.size();
+        while(p < end){
+            const char *stop = next_to_escape(p, end);
+            line.append(p, static_cast<size_t>(stop - p));
+            if(stop == end)
+                break;
+            switch(*stop){
+                case '"':  line += "\\\""; break;
+                case '\\': line += "\\\\"; break;
+                case '\n': line += "\\n"; break;
+                case '\r': line += "\\r"; break;
+                case '\t': line += "\\t"; break;
+                case '\b': line += "\\b"; break;
+                case '\f': line += "\\f"; break;
+                default:
+                    line += "\\u00";
+                    line += HEX[(static_cast<unsigned char>(*stop) >> 4) & 0xF];
+                    line += HEX[static_cast<unsigned char>(*stop) & 0xF];
+                    break;
+            }
+            p = stop + 1;
+        }
+    }
+    
     template <class MSG_T>
-    void form_and_push(const MSG_T &msg, const std::string &fname, const std::string &type){
+    void form_and_push(const MSG_T &msg, const std::string &fname, const std::string &type,
+                       const std::vector<logfield_t> &fields = {}){
         if(stop_logging_ || kill_){
 #ifdef PRINT_LIB_ERRORS
             fprintf(stderr, "Tried to log after destruction or kill order\n");
@@ -237,6 +984,18 @@ private:
             return;
         }
         
+        // With a function name the call site is known before the message is formatted, so a dropped
+        // message costs one hash and one CAS
+        bool limited = rate_interval_ns_.load(std::memory_order_relaxed) != 0;
+        size_t site = logmessage_t::NO_SITE;
+        if(limited && !fname.empty()){
+            site = site_of(type, fname);
+            if(!rate_allowed(site)){
+                count(&metrics_t::rateLimited);
+                return;
+            }
+        }
+        
         std::stringstream ss;
         if(!(ss << msg)){
 #ifdef PRINT_LIB_ERRORS
@@ -245,6 +1004,32 @@ private:
 #endif
             return;
         }
-        msg_queue_.push({ss.str(), fname, type});
+        logmessage_t lmsg(ss.str(), fname, type, fields);
+        if(limited && fname.empty()){
+            site = site_of(type, lmsg.message_to_be_logged_);
+            if(!rate_allowed(site)){
+                count(&metrics_t::rateLimited);
+                return;
+            }
+        }
+        lmsg.site_ = site;
+        lmsg.format_ = format_.load(std::memory_order_relaxed);
+        if(ring_.load(std::memory_order_relaxed))
+            record(lmsg);
+        count(&metrics_t::accepted);
+        
+        // Stamped and queued while busy_ is set so the consumer knows to wait for it, see sweep.
+        // Lock-free per-thread queue, the shared (locked) queue only takes the overflow
+        ring_t &ring = local_ring();
+        ring.busy_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        lmsg.time_ns_ = now_ns();
+        lmsg.seq_ = ring.next_seq_++;
+        if(!ring.queue_.try_push(std::move(lmsg))){
+            count(&metrics_t::overflowed);
+            msg_queue_.push(lmsg);
+        }
+        ring.busy_.store(false, std::memory_order_release);
+        wake_if_sleeping();
     }
 };
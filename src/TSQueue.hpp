@@ -13,6 +13,10 @@
 #include <mutex>
 #include <condition_variable>
 #include <chrono>
+#include <memory>
+#include <string>
+
+class MetricsRegistry;
 
 /**
  \brief Thread safe queue for c++
@@ -95,6 +99,8 @@ public:
         {
             std::unique_lock<std::mutex> mlock(mutex_);
             queue_.push(element);
+            if(metrics_)
+                metrics_->pushed(queue_.size());
         }
         condVar_.notify_one();
     }
@@ -118,6 +124,8 @@ public:
         // Same queue operations as normal
         auto element = std::move(queue_.front());
         queue_.pop();
+        if(metrics_)
+            metrics_->popped(queue_.size());
         return element;
     }
     
@@ -134,6 +142,8 @@ public:
             return false;
         item = std::move(queue_.front());
         queue_.pop();
+        if(metrics_)
+            metrics_->popped(queue_.size());
         return true;
     }
 
@@ -151,6 +161,8 @@ public:
             return false;
         item = std::move(queue_.front());
         queue_.pop();
+        if(metrics_)
+            metrics_->popped(queue_.size());
         return true;
     }
     
@@ -181,7 +193,27 @@ public:
         return queue_.size();
     }
     
+    /**
+        \brief Publish queue activity to a metrics registry
+        \details Adds <prefix>_pushed_total, <prefix>_popped_total, and <prefix>_depth. Updated while
+        the queue's lock is already held, so this adds no extra locking. Copies of the queue don't
+        publish. Defined in Metrics.hpp, include it to call this
+        @param registry Registry to publish to, must outlive the queue
+        @param prefix Metric name prefix, must be a valid Prometheus name
+    */
+    void publishMetrics(MetricsRegistry &registry, const std::string &prefix);
+    
 private:
+    // What publishMetrics hooks in, abstract so this header doesn't need Metrics.hpp. Called
+    // under mutex_
+    struct metrics_t{
+        virtual ~metrics_t() = default;
+        virtual void pushed(size_t depth) = 0;
+        virtual void popped(size_t depth) = 0;
+        virtual void resized(size_t depth) = 0;
+    };
+    
+    std::shared_ptr<metrics_t> metrics_;
     std::queue<T> queue_{};
     mutable MutexType mutex_;
     std::condition_variable condVar_;
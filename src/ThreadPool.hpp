@@ -17,14 +17,32 @@
 #include <future>
 #include <functional>
 #include <stdexcept>
+#include <atomic>
+#include <string>
+
+class MetricsRegistry;
 
 class ThreadPool {
 public:
     ThreadPool(size_t);
     template<class F, class... Args>
     auto push(F&& f, Args&&... args) -> std::future<typename std::result_of<F(Args...)>::type>;
+    // publish <prefix>_tasks_submitted_total, _tasks_completed_total, _queue_depth, and
+    // _task_seconds into registry. Defined in Metrics.hpp, include it to call this
+    void publishMetrics(MetricsRegistry &registry, const std::string &prefix = "threadpool");
     ~ThreadPool();
 private:
+    // what publishMetrics hooks in, abstract so this header doesn't need Metrics.hpp
+    struct metrics_t{
+        virtual ~metrics_t() = default;
+        // called under mQueueMutex
+        virtual void submitted() = 0;
+        virtual void queued(size_t depth) = 0;
+        virtual void run(const std::function<void()> &task) = 0;
+    };
+    std::unique_ptr<metrics_t> mMetricsOwner;
+    std::atomic<metrics_t *> mMetrics{nullptr};
+
     // need to keep track of threads so we can join them
     std::vector<std::thread> mWorkers;
     // the task queue
@@ -45,6 +63,7 @@ inline ThreadPool::ThreadPool(size_t threads)
             [this]{
                 while(true){
                     std::function<void()> task;
+                    metrics_t *metrics;
                                      
                     {
                         std::unique_lock<std::mutex> lock(this->mQueueMutex);
@@ -54,8 +73,14 @@ inline ThreadPool::ThreadPool(size_t threads)
                             return;
                         task = std::move(this->mTasks.front());
                         this->mTasks.pop();
+                        metrics = this->mMetrics.load(std::memory_order_acquire);
+                        if(metrics)
+                            metrics->queued(this->mTasks.size());
                     }
-                    task();
+                    if(metrics)
+                        metrics->run(task);
+                    else
+                        task();
                 }
         });
     }
@@ -79,6 +104,11 @@ auto ThreadPool::push(F&& f, Args&&... args) -> std::future<typename std::result
             throw std::runtime_error("push on stopped ThreadPool");
         
         mTasks.emplace([task](){ (*task)(); });
+        metrics_t *metrics = mMetrics.load(std::memory_order_acquire);
+        if(metrics){
+            metrics->submitted();
+            metrics->queued(mTasks.size());
+        }
     }
     mCondVar.notify_one();
     return res;
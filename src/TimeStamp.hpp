@@ -0,0 +1,206 @@
+//
+//  TimeStamp.hpp
+//  cppcommon
+//
+
+#pragma once
+
+#include <string>
+#include <chrono>
+#include <ctime>
+#include <cstring>
+#include <cstdint>
+
+/**
+    \brief Fast time stamp formatter
+    \details Renders "YEAR-MONTH-DAY HOUR:MINUTE:SECOND.FRACTION" without going through
+    std::stringstream / std::put_time. The "YEAR-MONTH-DAY HOUR:MINUTE:SECOND" prefix is cached and
+    only rebuilt when the second changes, every other call only renders the fractional part.\n
+    The cache is thread_local, a TimeStamp object itself is immutable after construction, so a
+    single TimeStamp can be shared between threads without any locking.\n
+    Supported clocks: \n
+    - LOCAL - wall clock time in the local time zone (default) \n
+    - UTC - wall clock time in UTC \n
+    - MONOTONIC - seconds elapsed since the TimeStamp was constructed, read from steady_clock
+    \date 10-18-26
+*/
+class TimeStamp{
+public:
+    enum class Clock{ LOCAL, UTC, MONOTONIC };
+    enum class Precision{ MILLI, MICRO };
+
+    /**
+        \brief Largest number of characters write() will produce, including the trailing '\0'
+    */
+    static const size_t MAX_LEN = 32;
+
+    /**
+        \brief c'tor
+        @param clock Which clock to render, defaults to local time
+        @param precision Milliseconds (3 digits) or microseconds (6 digits) after the second
+    */
+    TimeStamp(Clock clock = Clock::LOCAL, Precision precision = Precision::MILLI)
+        : clock_(clock)
+        , precision_(precision)
+        , sys_epoch_(std::chrono::system_clock::now())
+        , steady_epoch_(std::chrono::steady_clock::now())
+        {}
+
+    Clock clock() const { return clock_; }
+    Precision precision() const { return precision_; }
+
+    /**
+        \brief Time stamp for the current time
+        @return time stamp as a string
+    */
+    std::string now() const {
+        char buf[MAX_LEN];
+        size_t len = writeNow(buf);
+        return std::string(buf, len);
+    }
+
+    /**
+        \brief Time stamp for a specific point in time
+        \details MONOTONIC stamps are rendered relative to the system_clock time captured at
+        construction, points before construction are rendered as 0
+        @param tp The time point to format
+        @return time stamp as a string
+    */
+    std::string format(const std::chrono::system_clock::time_point &tp) const {
+        char buf[MAX_LEN];
+        size_t len = write(buf, tp);
+        return std::string(buf, len);
+    }
+
+    /**
+        \brief Write the time stamp for the current time into buf
+        @param buf Output buffer, must hold at least MAX_LEN characters
+        @return Number of characters written, not including the trailing '\0'
+    */
+    size_t writeNow(char *buf) const {
+        if(clock_ == Clock::MONOTONIC){
+            auto elapsed = std::chrono::steady_clock::now() - steady_epoch_;
+            return writeElapsed(buf, std::chrono::duration_cast<std::chrono::microseconds>(elapsed));
+        }
+        return write(buf, std::chrono::system_clock::now());
+    }
+
+    /**
+        \brief Write the time stamp for tp into buf
+        @param buf Output buffer, must hold at least MAX_LEN characters
+        @param tp The time point to format
+        @return Number of characters written, not including the trailing '\0'
+    */
+    size_t write(char *buf, const std::chrono::system_clock::time_point &tp) const {
+        using namespace std::chrono;
+        if(clock_ == Clock::MONOTONIC){
+            auto elapsed = tp < sys_epoch_ ? system_clock::duration::zero() : tp - sys_epoch_;
+            return writeElapsed(buf, duration_cast<microseconds>(elapsed));
+        }
+
+        auto us = duration_cast<microseconds>(tp.time_since_epoch()).count();
+        // Floor division so times before the epoch still get a non-negative fraction
+        int64_t secs = us / 1000000;
+        int64_t frac = us % 1000000;
+        if(frac < 0){
+            --secs;
+            frac += 1000000;
+        }
+
+        Cache &cache = clock_ == Clock::UTC ? utcCache() : localCache();
+        if(cache.secs != secs){
+            renderPrefix(cache.prefix, static_cast<time_t>(secs), clock_ == Clock::UTC);
+            cache.secs = secs;
+        }
+
+        std::memcpy(buf, cache.prefix, PREFIX_LEN);
+        size_t len = PREFIX_LEN;
+        buf[len++] = '.';
+        len += writeFraction(buf + len, frac);
+        buf[len] = '\0';
+        return len;
+    }
+
+private:
+    // "YYYY-MM-DD HH:MM:SS"
+    static const size_t PREFIX_LEN = 19;
+
+    struct Cache{
+        int64_t secs{INT64_MIN};
+        char prefix[PREFIX_LEN];
+    };
+
+    Clock clock_;
+    Precision precision_;
+    std::chrono::system_clock::time_point sys_epoch_;
+    std::chrono::steady_clock::time_point steady_epoch_;
+
+    // One cache per thread per clock, they never need to be shared so they never need a lock
+    static Cache &localCache(){
+        static thread_local Cache cache;
+        return cache;
+    }
+
+    static Cache &utcCache(){
+        static thread_local Cache cache;
+        return cache;
+    }
+
+    // Write val as exactly 'width' digits, left padded with zeros
+    static void writePadded(char *buf, int64_t val, size_t width){
+        for(size_t i = width; i > 0; --i){
+            buf[i - 1] = static_cast<char>('0' + val % 10);
+            val /= 10;
+        }
+    }
+
+    size_t writeFraction(char *buf, int64_t micros) const {
+        if(precision_ == Precision::MICRO){
+            writePadded(buf, micros, 6);
+            return 6;
+        }
+        writePadded(buf, micros / 1000, 3);
+        return 3;
+    }
+
+    size_t writeElapsed(char *buf, std::chrono::microseconds elapsed) const {
+        auto us = elapsed.count();
+        uint64_t secs = static_cast<uint64_t>(us / 1000000);
+
+        char digits[20];
+        size_t n = 0;
+        do{
+            digits[n++] = static_cast<char>('0' + secs % 10);
+            secs /= 10;
+        } while(secs);
+
+        size_t len = 0;
+        while(n)
+            buf[len++] = digits[--n];
+        buf[len++] = '.';
+        len += writeFraction(buf + len, us % 1000000);
+        buf[len] = '\0';
+        return len;
+    }
+
+    // Only called once per second per thread, the reentrant versions avoid the shared static tm
+    static void renderPrefix(char *buf, time_t secs, bool utc){
+        struct tm t;
+        if(utc)
+            gmtime_r(&secs, &t);
+        else
+            localtime_r(&secs, &t);
+
+        writePadded(buf, t.tm_year + 1900, 4);
+        buf[4] = '-';
+        writePadded(buf + 5, t.tm_mon + 1, 2);
+        buf[7] = '-';
+        writePadded(buf + 8, t.tm_mday, 2);
+        buf[10] = ' ';
+        writePadded(buf + 11, t.tm_hour, 2);
+        buf[13] = ':';
+        writePadded(buf + 14, t.tm_min, 2);
+        buf[16] = ':';
+        writePadded(buf + 17, t.tm_sec, 2);
+    }
+};
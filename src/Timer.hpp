@@ -10,40 +10,47 @@
 
 #include <chrono>
 #include <iostream>
+#include "TSCClock.hpp"
 
 using time_device = std::chrono::high_resolution_clock;
 using time_p = std::chrono::high_resolution_clock::time_point;
 
 /**
  \brief A simple code exection timer
- \details exetimer allows one to start and stop timer, and get the time between start and stop calls in seconds, milliseconds, microseconds, or nanoseconds
+ \details exetimer allows one to start and stop timer, and get the time between start and stop calls in seconds, milliseconds, microseconds, or nanoseconds.
+ The clock is a template policy, any std::chrono clock works. Timer uses high_resolution_clock,
+ TSCTimer uses the CPU time stamp counter (see TSCClock.hpp) which reads in a few nanoseconds
+ instead of a couple dozen, for timing very short sections of code.
  \note If the pause time is less than a full unit of your requested time the pause time is ignored. i.e if you paused a timer for 100 milliseconds and request your time in seconds the paused time will be ignored.
  \author Sean Grimes, spg63@cs.drexel.edu
  \date 11-30-15
 */
-
-class Timer{
+template <class Clock = time_device>
+class BasicTimer{
 public:
+    using clock_type = Clock;
+    using time_point = typename Clock::time_point;
+    
     /**
         \brief start the timer
     */
-    void startTimer() { start_ = time_device::now(); }
+    void startTimer() { start_ = Clock::now(); }
 
     /**
         \brief stop the timer
     */
-    void stopTimer() { stop_ = time_device::now(); }
+    void stopTimer() { stop_ = Clock::now(); }
     
     /**
         \brief pause the timer
     */
-    void pauseTimer() { pause_start_ = time_device::now(); }
+    void pauseTimer() { pause_start_ = Clock::now(); }
     
     /**
         \brief resumse a paused timer
     */
     void resumeTimer() {
-        pause_stop_ = time_device::now();
+        pause_stop_ = Clock::now();
         auto this_pause_duration = pause_stop_ - pause_start_;
         total_paused_time_ += std::chrono::duration_cast<std::chrono::nanoseconds>(this_pause_duration).count();
     }
@@ -102,15 +109,31 @@ public:
         exe_time_ns_ = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
         return exe_time_ns_ - total_paused_time_;
     }
+    
+    /**
+        \brief get time in CPU time stamp counter ticks
+        \details nanoseconds() converted to ticks at the calibrated TSC rate (1 tick per nanosecond
+        if there is no invariant TSC), so paused time is left out. Every clock, TSCTimer included,
+        stores nanoseconds, so this is not the raw rdtsc delta: it can be off from it by a few ticks
+        of rounding. TSC ticks run at the nominal CPU frequency, not the current one, so this equals
+        core cycles only when the core runs at nominal frequency.
+        @return number of ticks
+    */
+    double cycles() {
+        return nanoseconds() * TSC::ticksPerNs();
+    }
    
 private:
-    time_p start_;
-    time_p stop_;
-    time_p pause_start_;
-    time_p pause_stop_;
+    time_point start_;
+    time_point stop_;
+    time_point pause_start_;
+    time_point pause_stop_;
     double total_paused_time_{0.0};
     double exe_time_sec_{};
     double exe_time_ms_{};
     double exe_time_micro_{};
     double exe_time_ns_{};
 };
+
+using Timer = BasicTimer<>;
+using TSCTimer = BasicTimer<TSCClock>;
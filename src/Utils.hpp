@@ -14,6 +14,8 @@
 #include <chrono>
 #include <iomanip>
 #include <sstream>
+#include <string>
+#include "TimeStamp.hpp"
 
 namespace{
     inline void default_sig_handler_(int signum) { exit(signum); }
@@ -49,22 +51,14 @@ bool Utils::isSameType(T, U){
 }
 
 /**
- \brief Get current (localtime) time stamp using chrono
- \details time stamp format: YEAR-MONTH-DAY HOUR:MINUTE:SECOND.MILLISECOND
+ \brief Get current (localtime) time stamp
+ \details time stamp format: YEAR-MONTH-DAY HOUR:MINUTE:SECOND.MILLISECOND, see TimeStamp for
+ UTC / monotonic / microsecond stamps
  @return time stamp as a string
  */
 std::string Utils::timeStamp() {
-    using clock_t = std::chrono::system_clock;
-    auto now = clock_t::now();
-    auto count = clock_t::to_time_t(now);
-    auto secs = std::chrono::time_point_cast<std::chrono::milliseconds>(now);
-    auto partial = now - secs;
-    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(partial);
-
-    std::ostringstream oss;
-    oss << std::put_time(std::localtime(&count), "%Y-%m-%d %X");
-    oss << "." << ms.count();
-    return oss.str();
+    static const TimeStamp stamp;
+    return stamp.now();
 }
 
 /**
@@ -0,0 +1,116 @@
+//
+// AsyncIOTest.cpp
+//
+
+#include <fstream>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "../src/AsyncIO.hpp"
+#include "../src/FSUtils.hpp"
+
+// All caps is killing me
+#define require REQUIRE
+#define test_case TEST_CASE
+#define require_throws REQUIRE_THROWS
+
+namespace{
+    // Exercise one engine, small queues so batches have to be split
+    void exercise(AsyncIO &io){
+        const std::string dir{"async_io_test"};
+        FSUtils::deleteDir(dir);
+        FSUtils::makeDir(dir);
+        std::vector<std::string> paths;
+        for(int i = 0; i < 100; ++i){
+            paths.push_back(dir + "/f" + std::to_string(i));
+            std::ofstream(paths.back()) << std::string(static_cast<size_t>(i * 37), 'a' + i % 26);
+        }
+
+        auto contents = io.readFiles(paths);
+        require(contents.size() == paths.size());
+        for(size_t i = 0; i < paths.size(); ++i)
+            require(contents[i] == std::string(i * 37, static_cast<char>('a' + i % 26)));
+        require(io.readFiles({"/proc/self/status"})[0].find("Name:") != std::string::npos);
+        require(io.readFiles({}).empty());
+        require_throws(io.readFiles({paths[0], dir + "/missing"}));
+
+        // Write then read back through the future API
+        auto fd = io.open(dir + "/out", O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        io.wait();
+        int out = fd.get();
+        require(out >= 0);
+        const std::string msg{"hello async"};
+        auto wrote = io.write(out, msg.data(), msg.size(), 0);
+        io.wait();
+        require(wrote.get() == static_cast<int>(msg.size()));
+        auto closed = io.close(out);
+        io.wait();
+        require(closed.get() == 0);
+        require(FSUtils::readFullFile(dir + "/out") == msg);
+
+        // Lengths past what one read can return are clamped, not wrapped to len % 4 GiB
+        int in = ::open((dir + "/out").c_str(), O_RDONLY | O_CLOEXEC);
+        std::vector<char> whole(64);
+        auto huge = io.read(in, whole.data(), (size_t{1} << 32) + 4, 0);
+        io.wait();
+        require(huge.get() == static_cast<int>(msg.size()));
+        ::close(in);
+
+        struct statx stx;
+        auto st = io.stat(dir + "/out", &stx);
+        auto missing = io.open(dir + "/missing", O_RDONLY);
+        io.wait();
+        require(st.get() == 0);
+        require(stx.stx_size == msg.size());
+        require(missing.get() == -ENOENT);
+
+        // Callbacks, more at once than the queue holds
+        std::atomic<int> done{0}, bytes{0};
+        std::vector<char> buf(paths.size() * 64);
+        std::vector<int> fds;
+        for(auto &p : paths)
+            fds.push_back(::open(p.c_str(), O_RDONLY));
+        for(size_t i = 0; i < fds.size(); ++i)
+            io.read(fds[i], &buf[i * 64], 64, 0, [&](int res){
+                bytes += res;
+                ++done;
+            });
+        io.wait();
+        require(done == static_cast<int>(fds.size()));
+        int expected = 0;
+        for(size_t i = 0; i < paths.size(); ++i)
+            expected += static_cast<int>(std::min<size_t>(64, i * 37));
+        require(bytes == expected);
+        for(int f : fds)
+            ::close(f);
+
+        // Callbacks can queue more operations, wait() covers those too
+        int chained = -1;
+        std::vector<char> first(16);
+        io.open(paths[50], O_RDONLY, 0, [&](int f){
+            io.read(f, first.data(), first.size(), 0, [&, f](int res){
+                chained = res;
+                io.close(f, [](int){});
+            });
+        });
+        io.wait();
+        require(chained == 16);
+        require(std::string(first.data(), 16) == std::string(16, 'y'));
+
+        FSUtils::deleteDir(dir);
+    }
+}
+
+test_case("AsyncIO with io_uring"){
+    AsyncIO io(8);
+    // Not every kernel or sandbox allows io_uring, the fallback is tested below either way
+    if(io.usingUring())
+        exercise(io);
+}
+
+test_case("AsyncIO thread pool fallback"){
+    AsyncIO io(8, false);
+    require(!io.usingUring());
+    exercise(io);
+}
@@ -0,0 +1,65 @@
+//
+// BenchmarkTest.cpp
+//
+
+#include <sstream>
+#include "catch.hpp"
+#include "../src/Benchmark.hpp"
+
+// All caps is killing me
+#define require REQUIRE
+#define test_case TEST_CASE
+
+test_case("Benchmark run"){
+    Benchmark b;
+    b.warmup(std::chrono::milliseconds(1)).samples(5).minSampleTime(std::chrono::milliseconds(1));
+
+    int counter = 0;
+    auto r = b.run("increment", [&]{
+        ++counter;
+        Benchmark::doNotOptimize(counter);
+    });
+
+    require(r.name_ == "increment");
+    require(r.samples_ == 5);
+    require(r.iterations_ > 1);
+    require(r.min_ns_ <= r.median_ns_);
+    require(r.median_ns_ <= r.p99_ns_);
+    require(r.p99_ns_ <= r.max_ns_);
+    require(r.ops_per_sec_ > 0);
+    require(b.results().size() == 1);
+
+    // Still valid once later runs have grown results()
+    for(int i = 0; i < 8; ++i)
+        b.run("noop", []{ Benchmark::clobberMemory(); });
+    require(r.name_ == "increment");
+    require(b.results().size() == 9);
+    require(b.results()[0].median_ns_ == r.median_ns_);
+}
+
+test_case("Benchmark output"){
+    Benchmark b;
+    b.warmup(std::chrono::milliseconds(0)).samples(2).minSampleTime(std::chrono::milliseconds(1));
+    b.run("noop", []{ Benchmark::clobberMemory(); }, [](benchresult_t &r, size_t){
+        r.counters_.emplace_back("extra", 1.5);
+    });
+
+    std::ostringstream csv, json;
+    b.writeCSV(csv);
+    b.writeJSON(json);
+    require(csv.str().find("name,iterations,samples") == 0);
+    require(csv.str().find("\"noop\",") != std::string::npos);
+    require(csv.str().find("extra=1.5") != std::string::npos);
+    require(json.str().find("\"name\":\"noop\"") != std::string::npos);
+    require(json.str().find("\"counters\":{\"extra\":1.5}") != std::string::npos);
+
+    // Names are escaped, not written as is
+    Benchmark odd;
+    odd.warmup(std::chrono::milliseconds(0)).samples(2).minSampleTime(std::chrono::milliseconds(1));
+    odd.run("say \"hi\"\\\n", []{ Benchmark::clobberMemory(); });
+    std::ostringstream odd_csv, odd_json;
+    odd.writeCSV(odd_csv);
+    odd.writeJSON(odd_json);
+    require(odd_csv.str().find("\n\"say \"\"hi\"\"\\\n\",") != std::string::npos);
+    require(odd_json.str().find("\"name\":\"say \\\"hi\\\"\\\\\\n\",") != std::string::npos);
+}
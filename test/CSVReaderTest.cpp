@@ -0,0 +1,146 @@
+//
+// CSVReaderTest.cpp
+//
+
+#include <fstream>
+#include <vector>
+#include "catch.hpp"
+#include "../src/FSUtils.hpp"
+#include "../src/CsvMat.hpp"
+
+// All caps is killing me
+#define require REQUIRE
+#define test_case TEST_CASE
+#define require_throws REQUIRE_THROWS
+
+namespace{
+    using rows_t = std::vector<std::vector<std::string>>;
+
+    rows_t readAll(CSVReader csv){
+        rows_t rows;
+        while(csv.next())
+            rows.emplace_back(csv.row().begin(), csv.row().end());
+        return rows;
+    }
+}
+
+test_case("CSVReader RFC 4180"){
+    require(readAll(CSVReader::fromString("")).empty());
+    require(readAll(CSVReader::fromString("a,b,c\n1,2,3\n")) == rows_t{{"a", "b", "c"}, {"1", "2", "3"}});
+    require(readAll(CSVReader::fromString("a,b\r\n\r\n1,2")) == rows_t{{"a", "b"}, {"1", "2"}});
+    require(readAll(CSVReader::fromString("a,,\n,")) == rows_t{{"a", "", ""}, {"", ""}});
+    require(readAll(CSVReader::fromString("\"x,y\",\"line\nbreak\",\"say \"\"hi\"\"\"\n"))
+            == rows_t{{"x,y", "line\nbreak", "say \"hi\""}});
+    require(readAll(CSVReader::fromString("\"\",\"\"\"\"\n")) == rows_t{{"", "\""}});
+    require(readAll(CSVReader::fromString("\"quoted\"tail,in\"side,cr\rhere")) ==
+            rows_t{{"quotedtail", "in\"side", "cr\rhere"}});
+    require(readAll(CSVReader::fromString("\"unterminated,field")) == rows_t{{"unterminated,field"}});
+    require(readAll(CSVReader::fromString("a;'b;c';d", ';', '\'')) == rows_t{{"a", "b;c", "d"}});
+
+    // Long fields go through the 16 byte SIMD scan
+    std::string long_field(100, 'x');
+    require(readAll(CSVReader::fromString(long_field + "," + long_field + "\n"))
+            == rows_t{{long_field, long_field}});
+}
+
+test_case("CSVReader typed columns"){
+    auto csv = CSVReader::fromString("name,price,qty\nwidget, 1.5 ,3\ngadget,+2e3,-4\n");
+    require(csv.readHeader());
+    require(csv.header() == std::vector<std::string>{"name", "price", "qty"});
+    require(csv.column("qty") == 2);
+    require_throws(csv.column("missing"));
+
+    require(csv.next());
+    require(csv.row().get<std::string>(0) == "widget");
+    require(csv.row().get<double>(1) == Approx(1.5));
+    require(csv.row().get<int>(2) == 3);
+    require_throws(csv.row().get<int>(0));
+    require_throws(csv.row().get<int>(5));
+    require(csv.rowsRead() == 2);
+
+    auto prices = CSVReader::fromString("1\n2.5\n").readColumn<double>(0);
+    require(prices == std::vector<double>{1, 2.5});
+    auto reader = CSVReader::fromString("price\n1\n2.5\n");
+    reader.readHeader();
+    auto typed = reader.readColumn<float>("price");
+    require(typed.size() == 2);
+    require(typed[1] == Approx(2.5f));
+}
+
+test_case("CSVReader file and csvToMatrix"){
+    const std::string file{"csv_reader_test.csv"};
+    {
+        std::ofstream out(file, std::ios::binary);
+        out << "  id,\"name, full\",score  \n";
+        for(int i = 0; i < 1000; ++i)
+            out << i << ",\"user " << i << "\"," << i * 0.5 << "\r\n";
+    }
+    CSVReader csv(file);
+    csv.readHeader();
+    auto scores = csv.readColumn<double>(2);
+    require(scores.size() == 1000);
+    require(scores[999] == Approx(499.5));
+
+    auto matrix = FSUtils::csvToMatrix(file);
+    require(matrix.size() == 1001);
+    require(matrix[0] == std::vector<std::string>{"id", "name, full", "score"});
+    require(matrix[1][1] == "user 0");
+
+    FSUtils::deleteFile(file);
+    require_throws(CSVReader(file));
+}
+
+test_case("csvToMatrix row shape"){
+    const std::string file{"csv_matrix_test.csv"};
+    std::ofstream(file, std::ios::binary) << "1,2,\n\n3,,4\n   \r\n5,6,,\n,7\n,\n";
+    auto matrix = FSUtils::csvToMatrix(file);
+    require(matrix == std::vector<std::vector<std::string>>{
+        {"1", "2"}, {}, {"3", "", "4"}, {}, {"5", "6", ""}, {"", "7"}, {""}
+    });
+
+    // Blank lines are only kept when asked for
+    auto csv = CSVReader::fromString("a\n\r\nb\n");
+    size_t rows = 0;
+    while(csv.next())
+        ++rows;
+    require(rows == 2);
+    csv = CSVReader::fromString("a\n\r\nb\n");
+    csv.skipBlankLines(false);
+    require(csv.next());
+    require(csv.next());
+    require(csv.row().empty());
+    require(csv.next());
+    require(csv.row()[0] == "b");
+    require(!csv.next());
+    FSUtils::deleteFile(file);
+}
+
+test_case("FSUtils::loadNumericCsv"){
+    const std::string file{"load_numeric_test.csv"};
+    const size_t ROWS = 200000;
+    {
+        std::ofstream out(file, std::ios::binary);
+        out << "a,b,c,d\n";
+        for(size_t i = 0; i < ROWS; ++i)
+            out << i << ',' << i * 0.25 << ",-1.5e2, 7 \n";
+    }
+    Mat serial = FSUtils::loadNumericCsv(file, ',', true);
+    require(serial.rows() == ROWS);
+    require(serial.cols() == 4);
+    require(serial(10, 1) == Approx(2.5));
+    require(serial(ROWS - 1, 0) == Approx(ROWS - 1));
+    require(serial(3, 2) == Approx(-150));
+    require(serial(3, 3) == Approx(7));
+
+    ThreadPool pool(4);
+    Mat parallel = FSUtils::loadNumericCsv(file, pool, ',', true);
+    require(parallel.rows() == ROWS);
+    require(parallel.cols() == 4);
+    require(parallel.mat1d() == serial.mat1d());
+
+    require_throws(FSUtils::loadNumericCsv(file));
+    { std::ofstream out(file, std::ios::app); out << "1,2\n"; }
+    require_throws(FSUtils::loadNumericCsv(file, ',', true));
+    require_throws(FSUtils::loadNumericCsv(file, pool, ',', true));
+    FSUtils::deleteFile(file);
+}
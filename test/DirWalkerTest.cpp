@@ -0,0 +1,287 @@
+//
+// DirWalkerTest.cpp
+//
+
+#include <fstream>
+#include <set>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include "catch.hpp"
+#include "../src/FSUtils.hpp"
+#include "../src/ThreadPool.hpp"
+
+// All caps is killing me
+#define require REQUIRE
+#define test_case TEST_CASE
+#define require_throws REQUIRE_THROWS
+
+namespace{
+    const std::string TREE{"dir_walker_test"};
+
+    // TREE/a.txt, TREE/b.log, TREE/sub/c.txt, TREE/sub/deep/d.txt, TREE/link -> sub
+    void makeTree(){
+        FSUtils::deleteDir(TREE);
+        FSUtils::makeDir(TREE);
+        FSUtils::makeDir(TREE + "/sub");
+        FSUtils::makeDir(TREE + "/sub/deep");
+        for(auto f : {"/a.txt", "/b.log", "/sub/c.txt", "/sub/deep/d.txt"})
+            std::ofstream(TREE + f) << f;
+        symlink("sub", (TREE + "/link").c_str());
+    }
+
+    std::set<std::string> walk(DirWalker &w){
+        std::set<std::string> seen;
+        for(auto &e : w)
+            seen.emplace(e.relative());
+        return seen;
+    }
+}
+
+test_case("DirWalker walks the whole tree"){
+    makeTree();
+    DirWalker w(TREE);
+    std::set<std::string> all{"a.txt", "b.log", "sub", "sub/c.txt", "sub/deep", "sub/deep/d.txt",
+                              "link"};
+    require(walk(w) == all);
+
+    // Trailing slashes on the root don't change the paths
+    DirWalker slash(TREE + "//");
+    for(auto &e : slash){
+        require(e.path().substr(0, TREE.size() + 1) == TREE + "/");
+        require(e.path().substr(TREE.size() + 1) == e.relative());
+        require(e.path().substr(e.path().size() - e.name().size()) == e.name());
+        if(e.name() == "link")
+            require(e.isSymlink());
+        if(e.name() == "deep"){
+            require(e.isDir());
+            require(e.depth() == 1);
+        }
+    }
+    FSUtils::deleteDir(TREE);
+}
+
+test_case("DirWalker options"){
+    makeTree();
+    DirWalker shallow(TREE);
+    shallow.maxDepth(0);
+    require(walk(shallow) == std::set<std::string>{"a.txt", "b.log", "sub", "link"});
+
+    DirWalker txt(TREE);
+    txt.extension(".txt").includeDirs(false);
+    require(walk(txt) == std::set<std::string>{"a.txt", "sub/c.txt", "sub/deep/d.txt"});
+
+    DirWalker glob(TREE);
+    glob.glob("[bd]*").includeDirs(false);
+    require(walk(glob) == std::set<std::string>{"b.log", "sub/deep/d.txt"});
+
+    DirWalker dirs(TREE);
+    dirs.includeFiles(false).symlinks(DirWalker::Symlinks::SKIP);
+    require(walk(dirs) == std::set<std::string>{"sub", "sub/deep"});
+
+    // Following the link walks sub a second time
+    DirWalker follow(TREE);
+    follow.symlinks(DirWalker::Symlinks::FOLLOW).includeDirs(false);
+    require(walk(follow) == std::set<std::string>{"a.txt", "b.log", "sub/c.txt", "sub/deep/d.txt",
+                                                  "link/c.txt", "link/deep/d.txt"});
+
+    // Contents come before their directory
+    DirWalker post(TREE);
+    post.postOrder(true);
+    std::vector<std::string> order;
+    for(auto &e : post)
+        order.emplace_back(e.relative());
+    auto at = [&order](const std::string &rel){
+        return std::find(order.begin(), order.end(), rel) - order.begin();
+    };
+    require(order.size() == 7);
+    require(at("sub/c.txt") < at("sub"));
+    require(at("sub/deep") < at("sub"));
+    require(at("sub/deep/d.txt") < at("sub/deep"));
+
+    require_throws(DirWalker(TREE + "/a.txt").begin());
+    FSUtils::deleteDir(TREE);
+}
+
+test_case("DirWalker ends symlink cycles"){
+    makeTree();
+    symlink("..", (TREE + "/sub/up").c_str());
+    DirWalker w(TREE);
+    w.symlinks(DirWalker::Symlinks::FOLLOW).includeDirs(false).glob("d.txt");
+    size_t n = 0;
+    for(auto &e : w){
+        require(e.name() == "d.txt");
+        ++n;
+    }
+    // sub/deep/d.txt and link/deep/d.txt, up is never entered since it leads back to TREE
+    require(n == 2);
+    FSUtils::deleteDir(TREE);
+}
+
+test_case("FSUtils directory functions"){
+    makeTree();
+    auto files = FSUtils::getFilesInDir(TREE);
+    require(std::set<std::string>(files.begin(), files.end())
+            == std::set<std::string>{"a.txt", "b.log"});
+    require(FSUtils::getFilesInDir(TREE, ".log") == std::vector<std::string>{"b.log"});
+    auto dirs = FSUtils::getDirsInDir(TREE);
+    require(std::set<std::string>(dirs.begin(), dirs.end())
+            == std::set<std::string>{"sub", "link"});
+    require_throws(FSUtils::getFilesInDir(TREE + "/missing"));
+
+    const std::string copy{TREE + "_copy"}, moved{TREE + "_moved"};
+    FSUtils::deleteDir(copy);
+    FSUtils::deleteDir(moved);
+    require(FSUtils::copyd(TREE, copy));
+    require(FSUtils::readFullFile(copy + "/sub/deep/d.txt") == "/sub/deep/d.txt");
+    char target[16] = {0};
+    require(readlink((copy + "/link").c_str(), target, sizeof(target) - 1) == 3);
+    require(std::string(target) == "sub");
+
+    require(FSUtils::moved(copy, moved));
+    require(!FSUtils::dexists(copy));
+    require(FSUtils::readFullFile(moved + "/sub/c.txt") == "/sub/c.txt");
+    require(FSUtils::isFile(moved + "/link/c.txt"));
+
+    // Files can't be renamed across filesystems, they're left where they were
+    const std::string other{"/dev/shm/dir_walker_test_moved"};
+    struct stat here, there;
+    if(stat(".", &here) == 0 && stat("/dev/shm", &there) == 0 && here.st_dev != there.st_dev){
+        FSUtils::deleteDir(other);
+        require(!FSUtils::moved(moved + "/sub", other));
+        require(FSUtils::isFile(moved + "/sub/c.txt"));
+        require(FSUtils::isDir(other));
+        require(FSUtils::deleteDir(other));
+    }
+
+    // Removing the link mustn't remove what it points at
+    require(FSUtils::deleteDir(moved));
+    require(FSUtils::isFile(TREE + "/sub/c.txt"));
+    require(FSUtils::deleteDir(TREE));
+    require(!FSUtils::dexists(TREE));
+}
+
+test_case("FSUtils parallel tree operations"){
+    // 3 levels of 4 directories, each with 5 files of 10 bytes
+    const std::string root{"parallel_tree_test"}, copy{root + "_copy"};
+    FSUtils::deleteDir(root);
+    FSUtils::deleteDir(copy);
+    std::vector<std::string> level{root};
+    size_t dirs = 1, files = 0;
+    for(int depth = 0; depth < 3; ++depth){
+        std::vector<std::string> next;
+        for(auto &parent : level){
+            FSUtils::makeDir(parent);
+            for(int f = 0; f < 5; ++f, ++files)
+                std::ofstream(parent + "/f" + std::to_string(f)) << "0123456789";
+            for(int d = 0; d < 4; ++d, ++dirs)
+                next.push_back(parent + "/d" + std::to_string(d));
+        }
+        level.swap(next);
+    }
+    for(auto &leaf : level)
+        FSUtils::makeDir(leaf);
+    symlink("f0", (root + "/link").c_str());
+    ++files;
+
+    ThreadPool pool(4);
+    size_t calls = 0, last = 0;
+    auto scan = FSUtils::scanDir(root, pool, [&](const FSUtils::TreeProgress &p){
+        ++calls;
+        require(p.dirs_ == last + 1);
+        last = p.dirs_;
+    }, 2);
+    require(scan.dirs_ == dirs);
+    require(scan.files_ == files);
+    require(scan.bytes_ == (files - 1) * 10 + 2);
+    require(calls == dirs);
+
+    require(FSUtils::copyd(root, copy, pool));
+    auto copied = FSUtils::scanDir(copy, pool);
+    require(copied.dirs_ == dirs);
+    require(copied.files_ == files);
+    require(copied.bytes_ == scan.bytes_);
+    require(FSUtils::readFullFile(copy + "/d3/d2/f4") == "0123456789");
+    require_throws(FSUtils::copyd(root, copy, pool));
+
+    require(FSUtils::deleteDir(copy, pool, nullptr, 1));
+    require(!FSUtils::dexists(copy));
+    require(FSUtils::deleteDir(root, pool));
+    require(!FSUtils::dexists(root));
+    require_throws(FSUtils::scanDir(root, pool));
+}
+
+test_case("FSUtils parallel tree operations skip unreadable directories"){
+    const std::string root{"parallel_skip_test"}, copy{root + "_copy"};
+    FSUtils::deleteDir(root);
+    FSUtils::deleteDir(copy);
+    FSUtils::makeDir(root);
+    FSUtils::makeDir(root + "/open");
+    FSUtils::makeDir(root + "/open/shut");
+    std::ofstream(root + "/open/f") << "0123456789";
+    std::ofstream(root + "/open/shut/hidden") << "0123456789";
+    chmod((root + "/open/shut").c_str(), 0);
+    // Root can open it anyway
+    int fd = open((root + "/open/shut").c_str(), O_RDONLY | O_DIRECTORY);
+    if(fd != -1){
+        close(fd);
+        chmod((root + "/open/shut").c_str(), 0755);
+        FSUtils::deleteDir(root);
+        return;
+    }
+
+    ThreadPool pool(2);
+    auto scan = FSUtils::scanDir(root, pool);
+    require(scan.dirs_ == 3);
+    require(scan.files_ == 1);
+    require(scan.skipped_ == 1);
+    require(!FSUtils::copyd(root, copy, pool));
+    require(FSUtils::readFullFile(copy + "/open/f") == "0123456789");
+    require(FSUtils::isDir(copy + "/open/shut"));
+    require(!FSUtils::deleteDir(root, pool));
+    require(FSUtils::dexists(root + "/open/shut"));
+    require(!FSUtils::fexists(root + "/open/f"));
+
+    chmod((root + "/open/shut").c_str(), 0755);
+    require(FSUtils::deleteDir(root, pool));
+    require(FSUtils::deleteDir(copy, pool));
+}
+
+test_case("FSUtils::copyf"){
+    const std::string src{"copyf_test.bin"}, dst{"copyf_test_copy.bin"};
+    FSUtils::deleteFile(dst);
+    std::string data;
+    for(int i = 0; i < 300000; ++i)
+        data += static_cast<char>(i * 7);
+    std::ofstream(src, std::ios::binary) << data;
+    chmod(src.c_str(), 0640);
+    struct timespec old[2] = {{1000000000, 5}, {1000000000, 5}};
+    utimensat(AT_FDCWD, src.c_str(), old, 0);
+
+    require(FSUtils::copyf(src, dst));
+    require(FSUtils::readFullFile(dst) == data);
+    struct stat st;
+    stat(dst.c_str(), &st);
+    require(st.st_mtime != 1000000000);
+    require_throws(FSUtils::copyf(src, dst));
+    FSUtils::deleteFile(dst);
+
+    require(FSUtils::copyf(src, dst, true));
+    require(FSUtils::readFullFile(dst) == data);
+    stat(dst.c_str(), &st);
+    require(st.st_mtime == 1000000000);
+    require((st.st_mode & 0777) == 0640);
+    FSUtils::deleteFile(dst);
+
+    // Reports a size of 0 but has contents
+    require(FSUtils::copyf("/proc/self/status", dst));
+    require(FSUtils::readFullFile(dst).find("Name:") != std::string::npos);
+    FSUtils::deleteFile(dst);
+
+    std::ofstream(src, std::ios::trunc);
+    require(FSUtils::copyf(src, dst));
+    require(FSUtils::readFullFile(dst).empty());
+    require(!FSUtils::copyf("copyf_missing", dst + "2"));
+    FSUtils::deleteFile(dst);
+    FSUtils::deleteFile(src);
+}
@@ -0,0 +1,123 @@
+//
+// FileCacheTest.cpp
+//
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include "catch.hpp"
+#include "../src/FileCache.hpp"
+
+// All caps is killing me
+#define require REQUIRE
+#define test_case TEST_CASE
+#define require_throws REQUIRE_THROWS
+
+namespace{
+    void write(const std::string &path, const std::string &contents, long nsec){
+        std::ofstream(path, std::ios::trunc) << contents;
+        struct timespec times[2] = {{1600000000, nsec}, {1600000000, nsec}};
+        utimensat(AT_FDCWD, path.c_str(), times, 0);
+    }
+}
+
+test_case("FileCache shares and reloads contents"){
+    const std::string file{"file_cache_test.txt"};
+    write(file, "one\ntwo\n", 100);
+    FileCache cache;
+
+    auto first = cache.get(file);
+    require(first->lines() == std::vector<std::string_view>{"one", "two"});
+    require(cache.get(file) == first);
+    require(cache.size() == 1);
+    require(cache.bytes() == 8);
+    require(cache.stats().loads_ == 1);
+    require(cache.stats().hits_ == 1);
+
+    write(file, "three\n", 101);
+    auto second = cache.get(file);
+    require(second->text() == "three\n");
+    require(first->text() == "one\ntwo\n");
+    require(cache.bytes() == 6);
+    require(cache.stats().loads_ == 2);
+
+    require(cache.invalidate(file));
+    require(!cache.invalidate(file));
+    require(cache.size() == 0);
+    require(cache.get(file) != second);
+
+    require_throws(cache.get("file_cache_missing"));
+    require(!FSUtils::fexists("file_cache_missing"));
+    require_throws(cache.get("."));
+    FSUtils::deleteFile(file);
+}
+
+test_case("FileCache evicts least recently used"){
+    std::vector<std::string> files;
+    for(int i = 0; i < 4; ++i){
+        files.push_back("file_cache_lru" + std::to_string(i));
+        write(files.back(), std::string(100, 'a' + i), 100);
+    }
+
+    // Room for 3 by count, 250 bytes keeps it to 2
+    FileCache by_count(1000, 3);
+    for(auto &f : files)
+        by_count.get(f);
+    require(by_count.size() == 3);
+    require(by_count.stats().evictions_ == 1);
+
+    FileCache by_size(250);
+    by_size.get(files[0]);
+    by_size.get(files[1]);
+    by_size.get(files[0]);
+    by_size.get(files[2]);
+    // files[1] was the least recently used
+    require(by_size.size() == 2);
+    require(by_size.bytes() == 200);
+    auto loads = by_size.stats().loads_;
+    by_size.get(files[0]);
+    require(by_size.stats().loads_ == loads);
+    by_size.get(files[1]);
+    require(by_size.stats().loads_ == loads + 1);
+
+    // A single file bigger than the limit is still kept
+    FileCache tiny(10);
+    auto kept = tiny.get(files[3]);
+    require(tiny.size() == 1);
+    require(tiny.get(files[3]) == kept);
+
+    for(auto &f : files)
+        FSUtils::deleteFile(f);
+}
+
+test_case("FileCache from many threads"){
+    std::vector<std::string> files;
+    for(int i = 0; i < 8; ++i){
+        files.push_back("file_cache_mt" + std::to_string(i));
+        write(files.back(), std::string(1000, 'a' + i), 100);
+    }
+    FileCache cache(4000);
+    std::vector<std::thread> threads;
+    std::atomic<int> wrong{0};
+    for(int t = 0; t < 4; ++t)
+        threads.emplace_back([&, t]{
+            for(int i = 0; i < 500; ++i){
+                size_t f = static_cast<size_t>(i * (t + 1)) % files.size();
+                auto contents = cache.get(files[f]);
+                if(contents->text() != std::string(1000, static_cast<char>('a' + f)))
+                    ++wrong;
+            }
+        });
+    for(auto &t : threads)
+        t.join();
+    require(wrong == 0);
+    require(cache.bytes() <= 4000);
+    require(cache.size() <= 4);
+    auto stats = cache.stats();
+    require(stats.hits_ + stats.loads_ == 2000);
+
+    for(auto &f : files)
+        FSUtils::deleteFile(f);
+}
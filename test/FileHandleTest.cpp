@@ -0,0 +1,116 @@
+//
+// FileHandleTest.cpp
+//
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include "catch.hpp"
+#include "../src/FileHandle.hpp"
+
+// All caps is killing me
+#define require REQUIRE
+#define test_case TEST_CASE
+#define require_throws REQUIRE_THROWS
+
+namespace{
+    // Same size contents at a chosen mtime, so only the nanoseconds tell the versions apart
+    void rewrite(const std::string &path, const std::string &contents, long nsec){
+        std::ofstream(path, std::ios::trunc) << contents;
+        struct timespec times[2] = {{1600000000, nsec}, {1600000000, nsec}};
+        utimensat(AT_FDCWD, path.c_str(), times, 0);
+    }
+
+    // Notifications arrive on another thread, give them a moment
+    bool eventually(FileHandle &fh, const std::string &expected){
+        for(int i = 0; i < 2000; ++i){
+            if(fh.readAsString() == expected)
+                return true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return false;
+    }
+}
+
+test_case("FileHandle reloads on change"){
+    const std::string file{"file_handle_test.txt"};
+    FSUtils::deleteFile(file);
+    FileHandle fh(file);
+    require(fh.freshness() == FileHandle::Freshness::STAT);
+    require(fh.readAsString().empty());
+
+    rewrite(file, "one\ntwo\n", 100);
+    require(fh.readAsString() == "one\ntwo\n");
+    require(fh.readAsVector() == std::vector<std::string>{"one", "two"});
+    rewrite(file, "six\nten\n", 101);
+    require(fh.readAsString() == "six\nten\n");
+    require(fh.readAsVector() == std::vector<std::string>{"six", "ten"});
+
+    // Replaced by a rename, same size and mtime but a new inode
+    rewrite(file + ".new", "abc\ndef\n", 101);
+    std::rename((file + ".new").c_str(), file.c_str());
+    require(fh.readAsVector() == std::vector<std::string>{"abc", "def"});
+
+    FileHandle cleared(file, true);
+    require(cleared.readAsString().empty());
+    FSUtils::deleteFile(file);
+}
+
+test_case("FileHandle notify mode"){
+    const std::string file{"file_handle_notify.txt"};
+    FSUtils::deleteFile(file);
+    FileHandle fh(file, false, FileHandle::Freshness::NOTIFY);
+    // Not every sandbox allows inotify, STAT mode is the fallback
+    if(fh.freshness() != FileHandle::Freshness::NOTIFY)
+        return;
+    require(fh.readAsString().empty());
+
+    rewrite(file, "first", 100);
+    require(eventually(fh, "first"));
+    rewrite(file, "again", 100);
+    require(eventually(fh, "again"));
+
+    rewrite(file + ".new", "moved", 100);
+    std::rename((file + ".new").c_str(), file.c_str());
+    require(eventually(fh, "moved"));
+
+    // A second handle shares the watch, and it outlives the first
+    FileHandle other(file, false, FileHandle::Freshness::NOTIFY);
+    require(other.readAsString() == "moved");
+    {
+        FileHandle gone(file, false, FileHandle::Freshness::NOTIFY);
+        require(gone.readAsString() == "moved");
+    }
+    rewrite(file, "later", 100);
+    require(eventually(other, "later"));
+    require(eventually(fh, "later"));
+    FSUtils::deleteFile(file);
+}
+
+test_case("FileHandle shared contents"){
+    const std::string file{"file_handle_contents.txt"};
+    rewrite(file, "alpha\r\nbeta\n\ngamma", 100);
+    FileHandle fh(file);
+
+    auto first = fh.contents();
+    require(first->text() == "alpha\r\nbeta\n\ngamma");
+    require(first->lines() == std::vector<std::string_view>{"alpha", "beta", "", "gamma"});
+    // Unchanged, so the same load comes back and nothing is copied
+    require(fh.contents() == first);
+    require(&fh.text() == &first->text());
+    require(fh.lines().data() == first->lines().data());
+    require(fh.lines()[0].data() == first->text().data());
+    require(fh.readAsVector() == std::vector<std::string>{"alpha", "beta", "", "gamma"});
+
+    // A reload leaves earlier snapshots alone
+    rewrite(file, "delta\n", 101);
+    require(fh.lines() == std::vector<std::string_view>{"delta"});
+    require(fh.contents() != first);
+    require(first->text() == "alpha\r\nbeta\n\ngamma");
+    require(first->lines().size() == 4);
+    FSUtils::deleteFile(file);
+    require_throws(fh.text());
+}
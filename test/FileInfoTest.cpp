@@ -0,0 +1,71 @@
+//
+// FileInfoTest.cpp
+//
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <ctime>
+#include "catch.hpp"
+#include "../src/FSUtils.hpp"
+#include "../src/AsyncIO.hpp"
+
+// All caps is killing me
+#define require REQUIRE
+#define test_case TEST_CASE
+#define require_throws REQUIRE_THROWS
+
+test_case("FSUtils::fileInfo"){
+    const std::string file{"file_info_test.txt"}, link{"file_info_test.lnk"};
+    std::ofstream(file) << "twelve bytes";
+    chmod(file.c_str(), 0640);
+    struct timespec times[2] = {{1500000000, 123}, {1600000000, 456789}};
+    utimensat(AT_FDCWD, file.c_str(), times, 0);
+    unlink(link.c_str());
+    symlink(file.c_str(), link.c_str());
+
+    auto info = FSUtils::fileInfo(file);
+    require(info.exists());
+    require(info.isFile());
+    require(info.size_ == 12);
+    require(info.permissions() == 0640);
+    require(info.mtime_.tv_sec == 1600000000);
+    require(info.mtime_.tv_nsec == 456789);
+    require(info.mtimeNs() == 1600000000000456789LL);
+    require(info.atime_.tv_sec == 1500000000);
+    struct stat st;
+    stat(file.c_str(), &st);
+    require(info.inode_ == st.st_ino);
+    require(info.dev_ == st.st_dev);
+
+    auto followed = FSUtils::fileInfo(link);
+    require(followed.isFile());
+    require(followed.inode_ == info.inode_);
+    auto itself = FSUtils::fileInfo(link, false);
+    require(itself.isSymlink());
+    require(itself.inode_ != info.inode_);
+
+    require(FSUtils::fileInfo(".").isDir());
+    require(!FSUtils::fileInfo("file_info_missing").exists());
+
+    // The string getters agree with asctime
+    require(FSUtils::getPermissions(file) == "640");
+    time_t mtime = 1600000000;
+    std::string expected(asctime(localtime(&mtime)));
+    require(FSUtils::getModifiedTime(file) == expected.substr(0, expected.size() - 1));
+    require_throws(FSUtils::getAccessTime("file_info_missing"));
+
+    std::vector<std::string> paths{file, "file_info_missing", link, "."};
+    AsyncIO io(4);
+    for(auto &&batch : {FSUtils::fileInfo(paths), FSUtils::fileInfo(paths, io)}){
+        require(batch.size() == 4);
+        require(batch[0].inode_ == info.inode_);
+        require(batch[0].mtimeNs() == info.mtimeNs());
+        require(!batch[1].exists());
+        require(batch[2].isFile());
+        require(batch[3].isDir());
+    }
+
+    FSUtils::deleteFile(link);
+    FSUtils::deleteFile(file);
+}
@@ -0,0 +1,128 @@
+//
+// FileWatcherTest.cpp
+//
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+#include "catch.hpp"
+#include "../src/FileWatcher.hpp"
+#include "../src/FSUtils.hpp"
+
+// All caps is killing me
+#define require REQUIRE
+#define test_case TEST_CASE
+#define require_throws REQUIRE_THROWS
+
+namespace{
+    // Collects events from whatever thread they arrive on
+    struct Seen{
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::vector<FileWatcher::Event> events_;
+
+        FileWatcher::Callback callback(){
+            return [this](const FileWatcher::Event &ev){
+                std::lock_guard<std::mutex> lock(mutex_);
+                events_.push_back(ev);
+                cv_.notify_all();
+            };
+        }
+
+        // Wait for an event on path with kind, false after a few seconds without one
+        bool waitFor(const std::string &path, FileWatcher::Kind kind){
+            std::unique_lock<std::mutex> lock(mutex_);
+            return cv_.wait_for(lock, std::chrono::seconds(5), [&]{
+                for(auto &ev : events_)
+                    if(ev.path_ == path && ev.has(kind))
+                        return true;
+                return false;
+            });
+        }
+
+        size_t count(const std::string &path){
+            std::lock_guard<std::mutex> lock(mutex_);
+            size_t n = 0;
+            for(auto &ev : events_)
+                n += ev.path_ == path;
+            return n;
+        }
+
+        void clear(){
+            std::lock_guard<std::mutex> lock(mutex_);
+            events_.clear();
+        }
+    };
+}
+
+test_case("FileWatcher watches a file"){
+    const std::string dir{"file_watcher_test"}, file{dir + "/watched.txt"};
+    FSUtils::deleteDir(dir);
+    FSUtils::makeDir(dir);
+    ThreadPool pool(2);
+    FileWatcher watcher(pool, std::chrono::milliseconds(100));
+    Seen seen;
+
+    // Doesn't have to exist yet
+    int id = watcher.watch(file, seen.callback());
+    require(watcher.size() == 1);
+    std::ofstream(dir + "/other.txt") << "not this one";
+    {
+        std::ofstream out(file);
+        for(int i = 0; i < 50; ++i)
+            out << i << std::flush;
+    }
+    require(seen.waitFor(file, FileWatcher::CREATED));
+    require(seen.waitFor(file, FileWatcher::MODIFIED));
+    // The burst of writes lands inside one window
+    require(seen.count(file) <= 2);
+    require(seen.count(dir + "/other.txt") == 0);
+
+    seen.clear();
+    std::ofstream(dir + "/replacement") << "new";
+    std::rename((dir + "/replacement").c_str(), file.c_str());
+    require(seen.waitFor(file, FileWatcher::MOVED_IN));
+    FSUtils::deleteFile(file);
+    require(seen.waitFor(file, FileWatcher::DELETED));
+
+    require(watcher.unwatch(id));
+    require(!watcher.unwatch(id));
+    require(watcher.size() == 0);
+    require_throws(watcher.watch(dir + "/missing/file", seen.callback()));
+    FSUtils::deleteDir(dir);
+}
+
+test_case("FileWatcher watches a directory"){
+    const std::string dir{"file_watcher_tree"};
+    FSUtils::deleteDir(dir);
+    FSUtils::makeDir(dir);
+    FSUtils::makeDir(dir + "/sub");
+    // Callbacks on the watcher's thread, no coalescing
+    FileWatcher watcher(std::chrono::milliseconds(0));
+    Seen flat, deep;
+    watcher.watch(dir, flat.callback());
+    watcher.watch(dir + "/", deep.callback(), true);
+
+    std::ofstream(dir + "/a.txt") << "a";
+    require(flat.waitFor(dir + "/a.txt", FileWatcher::CREATED));
+    require(deep.waitFor(dir + "/a.txt", FileWatcher::CREATED));
+
+    // Existing and new subdirectories are only seen by the recursive watch
+    std::ofstream(dir + "/sub/b.txt") << "b";
+    require(deep.waitFor(dir + "/sub/b.txt", FileWatcher::MODIFIED));
+    FSUtils::makeDir(dir + "/sub/new");
+    require(deep.waitFor(dir + "/sub/new", FileWatcher::CREATED));
+    std::ofstream(dir + "/sub/new/c.txt") << "c";
+    require(deep.waitFor(dir + "/sub/new/c.txt", FileWatcher::MODIFIED));
+    require(flat.count(dir + "/sub/b.txt") == 0);
+
+    FSUtils::deleteDir(dir);
+    require(flat.waitFor(dir, FileWatcher::DELETED));
+    require(flat.waitFor(dir, FileWatcher::UNWATCHED));
+    require(deep.waitFor(dir, FileWatcher::UNWATCHED));
+}
@@ -0,0 +1,90 @@
+//
+// HistogramTest.cpp
+//
+
+#include <thread>
+#include <vector>
+#include "catch.hpp"
+#include "../src/Histogram.hpp"
+
+// All caps is killing me
+#define require REQUIRE
+#define test_case TEST_CASE
+#define require_throws REQUIRE_THROWS
+
+test_case("HistogramLayout buckets"){
+    HistogramLayout layout(7);
+    // Exact below 2^precision
+    for(uint64_t v = 0; v < 128; ++v){
+        require(layout.lowest(layout.index(v)) == v);
+        require(layout.highest(layout.index(v)) == v);
+    }
+    // Every value lands in a bucket that contains it, within the relative error
+    for(uint64_t v : std::vector<uint64_t>{128, 129, 1000, 123456789, uint64_t{1} << 40, UINT64_MAX}){
+        size_t idx = layout.index(v);
+        require(idx < layout.buckets());
+        require(layout.lowest(idx) <= v);
+        require(layout.highest(idx) >= v);
+        require(static_cast<double>(layout.highest(idx) - layout.lowest(idx)) <= v / 128.0);
+    }
+    require(layout.index(UINT64_MAX) == layout.buckets() - 1);
+    require_throws(HistogramLayout(0));
+    require_throws(HistogramLayout(17));
+}
+
+test_case("Histogram percentiles"){
+    Histogram h;
+    require(h.percentile(50) == 0);
+    for(uint64_t v = 1; v <= 10000; ++v)
+        h.record(v);
+
+    auto snap = h.snapshot();
+    require(snap.count() == 10000);
+    require(snap.min() == 1);
+    require(snap.max() == 10000);
+    require(snap.mean() == Approx(5000.5));
+    require(snap.median() == Approx(5000).epsilon(0.01));
+    require(snap.percentile(99) == Approx(9900).epsilon(0.01));
+    require(snap.percentile(100) == 10000);
+    require(snap.percentile(0) == 1);
+
+    h.record(std::chrono::microseconds(2));
+    h.recordNs(-5.0);
+    require(h.count() == 10002);
+    require(h.snapshot().min() == 0);
+
+    h.reset();
+    require(h.count() == 0);
+    require(h.snapshot().max() == 0);
+}
+
+test_case("Histogram concurrent record and merge"){
+    Histogram shared;
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<Histogram>> locals;
+    for(int t = 0; t < 4; ++t)
+        locals.emplace_back(new Histogram);
+    for(int t = 0; t < 4; ++t){
+        threads.emplace_back([&shared, &locals, t]{
+            for(uint64_t i = 0; i < 10000; ++i){
+                shared.record(i + t * 10000);
+                locals[t]->record(i + t * 10000);
+            }
+        });
+    }
+    for(auto &&t : threads)
+        t.join();
+
+    HistogramSnapshot merged;
+    for(auto &&l : locals)
+        merged.merge(l->snapshot());
+
+    auto snap = shared.snapshot();
+    require(snap.count() == 40000);
+    require(merged.count() == 40000);
+    require(merged.min() == 0);
+    require(merged.max() == 39999);
+    require(merged.counts() == snap.counts());
+    require(merged.percentile(50) == snap.percentile(50));
+    require_throws(merged.merge(HistogramSnapshot(5)));
+}
@@ -0,0 +1,66 @@
+//
+// LineRangeTest.cpp
+//
+
+#include <fstream>
+#include <vector>
+#include "catch.hpp"
+#include "../src/FSUtils.hpp"
+
+// All caps is killing me
+#define require REQUIRE
+#define test_case TEST_CASE
+#define require_throws REQUIRE_THROWS
+
+namespace{
+    std::vector<std::string> collect(const LineRange &range){
+        std::vector<std::string> out;
+        for(std::string_view line : range)
+            out.emplace_back(line);
+        return out;
+    }
+}
+
+test_case("LineRange splitting"){
+    using v = std::vector<std::string>;
+    require(collect(LineRange(std::string_view(""))).empty());
+    require(collect(LineRange(std::string_view("\n"))) == v{""});
+    require(collect(LineRange(std::string_view("a"))) == v{"a"});
+    require(collect(LineRange(std::string_view("a\nb\n"))) == v{"a", "b"});
+    require(collect(LineRange(std::string_view("a\r\n\r\nb"))) == v{"a", "", "b"});
+    require(collect(LineRange(std::string_view("a\n\nb\r"))) == v{"a", "", "b"});
+    require(collect(LineRange(std::string("owned\nlines"))) == v{"owned", "lines"});
+
+    LineRange range(std::string_view("one\ntwo\n"));
+    auto it = range.begin();
+    require(*it == "one");
+    require(it->size() == 3);
+    auto copy = it++;
+    require(*copy == "one");
+    require(*it == "two");
+    require(++it == range.end());
+}
+
+test_case("FSUtils::lines"){
+    const std::string file{"line_range_test.txt"};
+    {
+        std::ofstream out(file, std::ios::binary);
+        for(int i = 0; i < 1000; ++i)
+            out << "line " << i << (i % 2 ? "\r\n" : "\n");
+    }
+    size_t n = 0;
+    for(std::string_view line : FSUtils::lines(file)){
+        require(line == "line " + std::to_string(n));
+        ++n;
+    }
+    require(n == 1000);
+
+    auto vec = FSUtils::readLineByLine(file);
+    require(vec.size() == 1000);
+    require(vec[1] == "line 1");
+
+    { std::ofstream out(file, std::ios::trunc); }
+    require(FSUtils::lines(file).begin() == FSUtils::lines(file).end());
+    FSUtils::deleteFile(file);
+    require_throws(FSUtils::lines(file));
+}
@@ -0,0 +1,67 @@
+//
+// LogRingTest.cpp
+//
+
+#include <cstdio>
+#include <sstream>
+#include "catch.hpp"
+#include "../src/LogRing.hpp"
+
+// All caps is killing me
+#define require REQUIRE
+#define test_case TEST_CASE
+#define require_throws REQUIRE_THROWS
+
+namespace{
+    const std::string RING_FILE{"LogRingTest.ring"};
+}
+
+test_case("LogRing write and decode"){
+    std::remove(RING_FILE.c_str());
+    {
+        LogRing ring(RING_FILE, 8, 64);
+        require(ring.slots() == 8);
+        require(ring.slotSize() == 64);
+        ring.write("INFO", "first", 1);
+        ring.write("A_VERY_LONG_TYPE_NAME", std::string(100, 'x'), 2);
+    }
+
+    auto records = LogRing::decode(RING_FILE);
+    require(records.size() == 2);
+    require(records[0].seq_ == 0);
+    require(records[0].type_ == "INFO");
+    require(records[0].text_ == "first");
+    require(records[0].time_ns_ == 1);
+    // Type and text are truncated to fit the slot
+    require(records[1].type_ == "A_VERY_LONG");
+    require(records[1].text_ == std::string(32, 'x'));
+
+    std::remove(RING_FILE.c_str());
+}
+
+test_case("LogRing wraps and reopens"){
+    std::remove(RING_FILE.c_str());
+    {
+        LogRing ring(RING_FILE, 4);
+        for(int i = 0; i < 6; ++i)
+            ring.write("INFO", std::to_string(i));
+    }
+    {
+        // Same geometry, carries on after the existing records
+        LogRing ring(RING_FILE, 4);
+        ring.write("INFO", "6");
+    }
+
+    auto records = LogRing::decode(RING_FILE);
+    require(records.size() == 4);
+    require(records.front().text_ == "3");
+    require(records.back().text_ == "6");
+    require(records.back().seq_ == 6);
+
+    std::ostringstream oss;
+    require(LogRing::dump(RING_FILE, oss) == 4);
+    require(oss.str().find("INFO: 6\n") != std::string::npos);
+
+    std::remove(RING_FILE.c_str());
+    require_throws(LogRing::decode(RING_FILE));
+}
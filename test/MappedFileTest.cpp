@@ -0,0 +1,54 @@
+//
+// MappedFileTest.cpp
+//
+
+#include <fstream>
+#include "catch.hpp"
+#include "../src/FSUtils.hpp"
+
+// All caps is killing me
+#define require REQUIRE
+#define test_case TEST_CASE
+#define require_throws REQUIRE_THROWS
+
+namespace{
+    const std::string MAPPED_FILE{"mapped_file_test.txt"};
+}
+
+test_case("MappedFile view"){
+    std::string contents;
+    for(int i = 0; i < 10000; ++i)
+        contents += "line " + std::to_string(i) + "\n";
+    {
+        std::ofstream out(MAPPED_FILE, std::ios::binary);
+        out << contents;
+    }
+
+    MappedFile f(MAPPED_FILE, MappedFile::SEQUENTIAL | MappedFile::WILLNEED | MappedFile::HUGEPAGES);
+    require(f.size() == contents.size());
+    require(f.view() == contents);
+    require(std::string(f.begin(), f.end()) == contents);
+
+    MappedFile moved(std::move(f));
+    require(f.empty());
+    require(moved.view().substr(0, 7) == "line 0\n");
+
+    require(FSUtils::readFullFile(MAPPED_FILE) == contents);
+
+    { std::ofstream out(MAPPED_FILE, std::ios::trunc); }
+    MappedFile empty(MAPPED_FILE);
+    require(empty.empty());
+    require(empty.view().empty());
+    require(FSUtils::readFullFile(MAPPED_FILE).empty());
+
+    FSUtils::deleteFile(MAPPED_FILE);
+    require_throws(MappedFile(MAPPED_FILE));
+    require_throws(MappedFile("."));
+    require_throws(FSUtils::readFullFile(MAPPED_FILE));
+}
+
+test_case("readFullFile of unknown size"){
+    // /proc files report a size of 0
+    if(FSUtils::fexists("/proc/self/status"))
+        require(FSUtils::readFullFile("/proc/self/status").find("Name:") != std::string::npos);
+}
@@ -0,0 +1,138 @@
+//
+// MetricsTest.cpp
+//
+
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "catch.hpp"
+#include "../src/Metrics.hpp"
+#include "../src/ThreadPool.hpp"
+#include "../src/TSQueue.hpp"
+#include "../src/TSLogger.hpp"
+#include "../src/FSUtils.hpp"
+
+// All caps is killing me
+#define require REQUIRE
+#define test_case TEST_CASE
+#define require_throws REQUIRE_THROWS
+
+test_case("Metrics counters, gauges, and timers"){
+    MetricsRegistry reg;
+    Counter &c = reg.counter("requests_total", "Requests served");
+    require(&reg.counter("requests_total") == &c);
+
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 8; ++t)
+        threads.emplace_back([&c]{ for(int i = 0; i < 10000; ++i) c.inc(); });
+    for(auto &&t : threads)
+        t.join();
+    require(c.value() == 80000);
+
+    Gauge &g = reg.gauge("depth");
+    g.set(5);
+    g.add(-2);
+    require(g.value() == Approx(3));
+
+    TimerMetric &tm = reg.timer("latency_seconds");
+    tm.record(std::chrono::milliseconds(2));
+    {
+        ScopedTimer timed(tm);
+    }
+    require(tm.snapshot().count() == 2);
+
+    require_throws(reg.gauge("requests_total"));
+    require_throws(reg.counter("bad name"));
+    require_throws(reg.counter("9lives"));
+
+    std::string text = reg.prometheusText();
+    require(text.find("# HELP requests_total Requests served\n# TYPE requests_total counter\n"
+                      "requests_total 80000\n") != std::string::npos);
+    require(text.find("# TYPE depth gauge\ndepth 3\n") != std::string::npos);
+    require(text.find("# TYPE latency_seconds summary\n") != std::string::npos);
+    require(text.find("latency_seconds{quantile=\"0.99\"} 0.002") != std::string::npos);
+    require(text.find("latency_seconds_count 2\n") != std::string::npos);
+
+    // Values keep every digit, and non finite ones use Prometheus' spelling
+    reg.gauge("precise").set(1234567.125);
+    reg.gauge("tiny").set(1e-12);
+    reg.gauge("missing").set(std::nan(""));
+    reg.gauge("unbounded").set(-HUGE_VAL);
+    text = reg.prometheusText();
+    require(text.find("\nprecise 1234567.125\n") != std::string::npos);
+    require(text.find("\ntiny 1e-12\n") != std::string::npos);
+    require(text.find("\nmissing NaN\n") != std::string::npos);
+    require(text.find("\nunbounded -Inf\n") != std::string::npos);
+}
+
+test_case("Metrics published by ThreadPool, TSQueue, and TSLogger"){
+    MetricsRegistry reg;
+    {
+        ThreadPool pool(2);
+        pool.publishMetrics(reg, "pool");
+        std::vector<std::future<int>> results;
+        for(int i = 0; i < 50; ++i)
+            results.push_back(pool.push([i]{ return i; }));
+        for(auto &&r : results)
+            r.get();
+    }
+    require(reg.counter("pool_tasks_submitted_total").value() == 50);
+    require(reg.counter("pool_tasks_completed_total").value() == 50);
+    require(reg.gauge("pool_queue_depth").value() == Approx(0));
+    require(reg.timer("pool_task_seconds").snapshot().count() == 50);
+
+    TSQueue<int> q;
+    q.publishMetrics(reg, "queue");
+    q.push(1);
+    q.push(2);
+    int val;
+    q.try_and_pop(val);
+    require(reg.counter("queue_pushed_total").value() == 2);
+    require(reg.counter("queue_popped_total").value() == 1);
+    require(reg.gauge("queue_depth").value() == Approx(1));
+
+    const std::string log_file{"metrics_test_log.txt"};
+    {
+        TSLogger logger(log_file);
+        logger.publishMetrics(reg, "log");
+        logger.info("one");
+        logger.info("two");
+    }
+    require(reg.counter("log_messages_total").value() == 2);
+    require(reg.counter("log_lines_written_total").value() == 2);
+    FSUtils::deleteFile(log_file);
+}
+
+test_case("MetricsExporter file and socket"){
+    MetricsRegistry reg;
+    reg.counter("exported_total").inc(7);
+
+    const std::string file{"metrics_test.prom"};
+    {
+        MetricsExporter exporter(reg, file);
+        require(exporter.exportNow());
+    }
+    require(FSUtils::readFullFile(file).find("exported_total 7\n") != std::string::npos);
+    FSUtils::deleteFile(file);
+
+    const std::string sock_path{"metrics_test.sock"};
+    MetricsExporter exporter(reg, sock_path, MetricsExporter::Target::UNIX_SOCKET);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    require(fd >= 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strcpy(addr.sun_path, sock_path.c_str());
+    require(connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0);
+    std::string text;
+    char buf[256];
+    ssize_t n;
+    while((n = read(fd, buf, sizeof(buf))) > 0)
+        text.append(buf, static_cast<size_t>(n));
+    close(fd);
+    require(text.find("exported_total 7\n") != std::string::npos);
+}
@@ -0,0 +1,76 @@
+//
+// ParallelLinesTest.cpp
+//
+
+#include <fstream>
+#include <atomic>
+#include <vector>
+#include "catch.hpp"
+#include "../src/FSUtils.hpp"
+
+// All caps is killing me
+#define require REQUIRE
+#define test_case TEST_CASE
+#define require_throws REQUIRE_THROWS
+
+test_case("FSUtils::splitLineChunks"){
+    std::string text;
+    for(int i = 0; i < 1000; ++i)
+        text += std::to_string(i) + (i % 3 ? "\n" : "\r\n");
+    for(size_t n : {1, 2, 7, 64, 5000}){
+        auto chunks = FSUtils::splitLineChunks(text, n);
+        require(chunks.size() <= n);
+        std::string joined;
+        for(auto c : chunks){
+            require(!c.empty());
+            require(c.back() == '\n');
+            joined += c;
+        }
+        require(joined == text);
+    }
+    require(FSUtils::splitLineChunks("", 4).empty());
+    auto tail = FSUtils::splitLineChunks("a\nb\nno newline", 3);
+    require(tail.back() == "no newline");
+}
+
+test_case("FSUtils::parallelLines"){
+    // Big enough to be split across the pool
+    const std::string file{"parallel_lines_test.txt"};
+    const size_t LINES = 400000;
+    {
+        std::ofstream out(file, std::ios::binary);
+        for(size_t i = 0; i < LINES; ++i)
+            out << i << '\n';
+    }
+    ThreadPool pool(4);
+
+    require(FSUtils::lineCount(file, pool) == LINES);
+    require(FSUtils::lineCount(file, pool) == FSUtils::lineCount(file));
+
+    std::atomic<size_t> seen{0};
+    FSUtils::parallelLines(file, pool, [&seen](std::string_view line){
+        if(!line.empty())
+            seen.fetch_add(1, std::memory_order_relaxed);
+    });
+    require(seen == LINES);
+
+    // Ordered reduce, concatenating gives the lines back in file order
+    auto all = FSUtils::parallelLines(file, pool, std::vector<size_t>{},
+        [](std::vector<size_t> &v, std::string_view line){ v.push_back(std::stoul(std::string(line))); },
+        [](std::vector<size_t> &&a, std::vector<size_t> &&b){
+            a.insert(a.end(), b.begin(), b.end());
+            return std::move(a);
+        });
+    require(all.size() == LINES);
+    bool ordered = true;
+    for(size_t i = 0; i < all.size(); ++i)
+        ordered = ordered && all[i] == i;
+    require(ordered);
+
+    require_throws(FSUtils::parallelLines(file, pool, [](std::string_view line){
+        if(line == "12345")
+            throw std::runtime_error("bad line");
+    }));
+
+    FSUtils::deleteFile(file);
+}
@@ -0,0 +1,50 @@
+//
+// PerfCountersTest.cpp
+//
+
+#include "catch.hpp"
+#include "../src/PerfCounters.hpp"
+#include "../src/Benchmark.hpp"
+
+// All caps is killing me
+#define require REQUIRE
+#define test_case TEST_CASE
+
+test_case("PerfCounters region"){
+    PerfCounters pc;
+    pc.startCounters();
+    volatile uint64_t sum = 0;
+    for(uint64_t i = 0; i < 100000; ++i)
+        sum += i;
+    pc.stopCounters();
+
+    std::string report = pc.report();
+    for(int e = 0; e < PerfCounters::EVENT_COUNT; ++e){
+        auto event = static_cast<PerfCounters::Event>(e);
+        require(report.find(std::string(PerfCounters::name(event)) + "=") != std::string::npos);
+        if(!pc.available(event)){
+            require(pc.value(event) == 0);
+            require(!pc.error().empty());
+        }
+    }
+    if(pc.available(PerfCounters::INSTRUCTIONS))
+        require(pc.value(PerfCounters::INSTRUCTIONS) >= 100000);
+    if(!pc.available())
+        require(report.find("unavailable") != std::string::npos);
+}
+
+test_case("Benchmark hardware counters"){
+    Benchmark b;
+    b.warmup(std::chrono::milliseconds(1)).samples(2).minSampleTime(std::chrono::milliseconds(1));
+    b.hardwareCounters(true);
+    auto &&res = b.run("noop", []{ Benchmark::clobberMemory(); });
+    PerfCounters pc;
+    if(pc.available(PerfCounters::CYCLES)){
+        require(!res.counters_.empty());
+        require(res.counters_[0].first == "cycles");
+    }
+    else{
+        for(auto &&c : res.counters_)
+            require(c.first != "cycles");
+    }
+}
@@ -0,0 +1,86 @@
+//
+// ProfilerTest.cpp
+//
+
+#include <thread>
+#include <sstream>
+#include "catch.hpp"
+#include "../src/Profiler.hpp"
+
+// All caps is killing me
+#define require REQUIRE
+#define test_case TEST_CASE
+
+namespace{
+    double ns(uint64_t start, uint64_t end){
+        return static_cast<double>(TSC::toNs(end) - TSC::toNs(start));
+    }
+}
+
+test_case("Profiler inclusive / exclusive"){
+    Profiler::reset();
+    uint64_t base = TSC::ticks() + 1000;
+
+    // outer [0, 10000] contains inner [1000, 4000] and inner [5000, 6000]
+    Profiler::record("inner", base + 1000, base + 4000, 1);
+    Profiler::record("inner", base + 5000, base + 6000, 1);
+    Profiler::record("outer", base, base + 10000, 0);
+
+    auto stats = Profiler::stats();
+    require(stats.size() == 2);
+    require(stats[0].name_ == "outer");
+    require(stats[0].count_ == 1);
+    require(stats[1].name_ == "inner");
+    require(stats[1].count_ == 2);
+
+    double inner = ns(base + 1000, base + 4000) + ns(base + 5000, base + 6000);
+    require(stats[1].inclusive_ns_ == Approx(inner));
+    require(stats[1].exclusive_ns_ == Approx(inner));
+    require(stats[0].inclusive_ns_ == Approx(ns(base, base + 10000)));
+    require(stats[0].exclusive_ns_ == Approx(ns(base, base + 10000) - inner));
+}
+
+test_case("ProfileZone records per thread"){
+    Profiler::reset();
+    uint32_t nested_depth = 0;
+    std::thread t([&nested_depth]{
+        ProfileZone outer("thread zone");
+        ProfileZone inner("nested zone");
+        nested_depth = Profiler::depth();
+    });
+    t.join();
+    require(nested_depth == 2);
+    require(Profiler::depth() == 0);
+
+    auto stats = Profiler::stats();
+    require(stats.size() == 2);
+    require(stats[0].name_ == "thread zone");
+
+    std::ostringstream trace;
+    Profiler::exportChromeTrace(trace);
+    require(trace.str().find("\"name\":\"nested zone\",\"ph\":\"X\"") != std::string::npos);
+
+    std::ostringstream report;
+    Profiler::report(report);
+    require(report.str().find("thread zone") != std::string::npos);
+}
+
+test_case("Profiler reset frees chunks and each thread is bounded"){
+    Profiler::reset();
+    size_t base_bytes = Profiler::bytes();
+    std::thread t([]{
+        uint64_t start = TSC::ticks();
+        for(size_t i = 0; i < (Profiler::MAX_CHUNKS + 2) * Profiler::CHUNK_EVENTS; ++i)
+            Profiler::record("bounded", start, start + 1, 0);
+    });
+    t.join();
+    size_t capped = Profiler::bytes();
+    require(capped > base_bytes);
+    require(Profiler::dropped() >= Profiler::CHUNK_EVENTS);
+    require(Profiler::stats()[0].count_ <= Profiler::MAX_CHUNKS * Profiler::CHUNK_EVENTS);
+
+    Profiler::reset();
+    require(Profiler::bytes() < capped);
+    require(Profiler::dropped() == 0);
+    require(Profiler::stats().empty());
+}
@@ -0,0 +1,66 @@
+//
+// SPSCQueueTest.cpp
+//
+
+#include <thread>
+#include <string>
+#include "catch.hpp"
+#include "../src/SPSCQueue.hpp"
+
+// All caps is killing me
+#define require REQUIRE
+#define test_case TEST_CASE
+#define require_false REQUIRE_FALSE
+
+test_case("SPSCQueue capacity"){
+    SPSCQueue<int> q(5);
+    require(q.capacity() == 8);
+    require(q.empty());
+
+    for(int i = 0; i < 8; ++i)
+        require(q.try_push(i));
+    require_false(q.try_push(8));
+    require(q.size() == 8);
+
+    int val = -1;
+    for(int i = 0; i < 8; ++i){
+        require(q.try_pop(val));
+        require(val == i);
+    }
+    require_false(q.try_pop(val));
+    require(q.empty());
+}
+
+test_case("SPSCQueue failed push keeps item"){
+    SPSCQueue<std::string> q(2);
+    std::string a{"a"}, b{"b"}, c{"c"};
+    require(q.try_push(std::move(a)));
+    require(q.try_push(std::move(b)));
+    require_false(q.try_push(std::move(c)));
+    require(c == "c");
+}
+
+test_case("SPSCQueue producer / consumer threads"){
+    const int COUNT = 100000;
+    SPSCQueue<int> q(64);
+    std::thread producer([&q]{
+        for(int i = 0; i < COUNT; ++i)
+            while(!q.try_push(i))
+                std::this_thread::yield();
+    });
+
+    bool in_order = true;
+    int expected = 0, val = 0;
+    while(expected < COUNT){
+        if(q.try_pop(val)){
+            if(val != expected)
+                in_order = false;
+            ++expected;
+        }
+        else
+            std::this_thread::yield();
+    }
+    producer.join();
+    require(in_order);
+    require(q.empty());
+}
@@ -0,0 +1,273 @@
+//
+// TSLoggerTest.cpp
+//
+
+#include <string>
+#include <vector>
+#include <limits>
+#include <thread>
+#include <chrono>
+#include "catch.hpp"
+#include "../src/TSLogger.hpp"
+#include "../src/FSUtils.hpp"
+
+// All caps is killing me
+#define require REQUIRE
+#define test_case TEST_CASE
+#define require_throws REQUIRE_THROWS
+
+namespace{
+    const std::string LOG_FILE{"tslogger_test.log"};
+
+    // Everything after the time stamp (date and time) of TEXT lines
+    std::string afterTime(const std::string &line){
+        return line.substr(line.find(' ', line.find(' ') + 1) + 1);
+    }
+
+    // Everything after "time":"...", for JSON lines
+    std::string afterJsonTime(const std::string &line){
+        return line.substr(line.find("\",\"level\"") + 2);
+    }
+
+    // Everything after time="...", for logfmt lines
+    std::string afterLogfmtTime(const std::string &line){
+        return line.substr(line.find("\" level=") + 2);
+    }
+}
+
+test_case("TSLogger field values"){
+    FSUtils::deleteFile(LOG_FILE);
+    {
+        TSLogger logger(LOG_FILE);
+        logger.info("fields", LogFields()
+                    .add("half", 1.5)
+                    .add("tiny", 1e-9)
+                    .add("third", 1.0 / 3)
+                    .add("f", 0.1f)
+                    .add("n", -42)
+                    .add("big", 18446744073709551615ULL)
+                    .add("c", 'x')
+                    .add("ok", true)
+                    .add("nan", std::numeric_limits<double>::quiet_NaN())
+                    .add("s", std::string("two words")));
+    }
+    auto lines = FSUtils::readLineByLine(LOG_FILE);
+    require(lines.size() == 1);
+    require(afterTime(lines[0]) == "INFO: fields half=1.5 tiny=1e-09 third=0.3333333333333333 f=0.1 "
+                                   "n=-42 big=18446744073709551615 c=x ok=true nan=nan s=\"two words\"");
+    FSUtils::deleteFile(LOG_FILE);
+}
+
+test_case("TSLogger JSON and logfmt rendering"){
+    FSUtils::deleteFile(LOG_FILE);
+    const std::string nasty{"say \"hi\"\\\n\tbell\x07 a=b"};
+    {
+        TSLogger logger(LOG_FILE);
+        logger.setFormat(TSLogger::Format::JSON);
+        logger.warn(nasty, LogFields().add("key\"q", nasty).add("n", 2.5).add("c", 'y')
+                                         .add("inf", std::numeric_limits<double>::infinity()),
+                       "fn");
+        logger.setFormat(TSLogger::Format::LOGFMT);
+        logger.error(nasty, LogFields().add("plain", "word").add("empty", "").add("n", 7), "fn");
+        logger.info("no func");
+    }
+    auto lines = FSUtils::readLineByLine(LOG_FILE);
+    require(lines.size() == 3);
+    require(lines[0].substr(0, 9) == "{\"time\":\"");
+    require(afterJsonTime(lines[0])
+            == "\"level\":\"WARNING\",\"func\":\"fn\",\"msg\":\"say \\\"hi\\\"\\\\\\n\\tbell\\u0007 a=b\","
+               "\"key\\\"q\":\"say \\\"hi\\\"\\\\\\n\\tbell\\u0007 a=b\",\"n\":2.5,\"c\":\"y\",\"inf\":\"inf\"}");
+    require(lines[1].substr(0, 6) == "time=\"");
+    require(afterLogfmtTime(lines[1])
+            == "level=ERROR func=fn msg=\"say \\\"hi\\\"\\\\\\n\\tbell\\u0007 a=b\" plain=word empty=\"\" n=7");
+    require(afterLogfmtTime(lines[2]) == "level=INFO msg=\"no func\"");
+    FSUtils::deleteFile(LOG_FILE);
+}
+
+test_case("TSLogger keeps the format a message was logged with"){
+    FSUtils::deleteFile(LOG_FILE);
+    {
+        TSLogger logger(LOG_FILE);
+        // Changed straight away, before the logger thread has written the first message
+        logger.info("as text");
+        logger.setFormat(TSLogger::Format::JSON);
+        logger.info("as json");
+        logger.setFormat(TSLogger::Format::TEXT);
+    }
+    auto lines = FSUtils::readLineByLine(LOG_FILE);
+    require(lines.size() == 2);
+    require(afterTime(lines[0]) == "INFO: as text");
+    require(afterJsonTime(lines[1]) == "\"level\":\"INFO\",\"msg\":\"as json\"}");
+    FSUtils::deleteFile(LOG_FILE);
+}
+
+test_case("TSLogger collapses duplicate messages"){
+    FSUtils::deleteFile(LOG_FILE);
+    {
+        TSLogger logger(LOG_FILE);
+        logger.setCollapseDuplicates(true);
+        for(int i = 0; i < 5; ++i)
+            logger.info("same", "fn");
+        logger.info("same", LogFields().add("k", 1), "fn");
+        logger.info("same", LogFields().add("k", 2), "fn");
+        logger.warn("other", "fn");
+        logger.warn("other", "fn");
+        logger.warn("other", "fn");
+        // The once a second report covers a run that's still going
+        std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+        logger.warn("other", "fn");
+        logger.warn("other", "fn");
+    }
+    auto lines = FSUtils::readLineByLine(LOG_FILE);
+    std::vector<std::string> body;
+    for(auto &l : lines)
+        body.push_back(afterTime(l));
+    require(body == std::vector<std::string>{
+        "INFO: fn: same",
+        "INFO: fn: last message repeated 4 times",
+        "INFO: fn: same k=1",
+        "INFO: fn: same k=2",
+        "WARNING: fn: other",
+        "WARNING: fn: last message repeated 2 times",
+        // Written on shutdown
+        "WARNING: fn: last message repeated 2 times"
+    });
+    FSUtils::deleteFile(LOG_FILE);
+}
+
+test_case("TSLogger rate limit"){
+    FSUtils::deleteFile(LOG_FILE);
+    {
+        TSLogger logger(LOG_FILE);
+        // One every 50ms, up to 3 at once
+        logger.setRateLimit(20, 3);
+        for(int i = 0; i < 10; ++i)
+            logger.info("burst", "fn");
+        // A different call site has its own bucket
+        logger.info("elsewhere", "other_fn");
+        // Refills to the burst size, not past it
+        std::this_thread::sleep_for(std::chrono::milliseconds(400));
+        for(int i = 0; i < 10; ++i)
+            logger.info("refilled", "fn");
+    }
+    auto lines = FSUtils::readLineByLine(LOG_FILE);
+    size_t burst = 0, refilled = 0, elsewhere = 0, dropped = 0;
+    for(auto &l : lines){
+        std::string body = afterTime(l);
+        burst += body == "INFO: fn: burst";
+        refilled += body == "INFO: fn: refilled";
+        elsewhere += body == "INFO: other_fn: elsewhere";
+        const std::string summary{"WARNING: rate limit dropped "};
+        if(body.compare(0, summary.size(), summary) == 0){
+            require(body.substr(body.find(" messages from ")) == " messages from INFO: fn");
+            dropped += std::stoul(body.substr(summary.size()));
+        }
+    }
+    require(burst == 3);
+    require(refilled == 3);
+    require(elsewhere == 1);
+    require(dropped == 14);
+    FSUtils::deleteFile(LOG_FILE);
+}
+
+test_case("TSLogger keeps each thread's order"){
+    FSUtils::deleteFile(LOG_FILE);
+    const int threads = 4, per_thread = 3000;
+    {
+        TSLogger logger(LOG_FILE);
+        std::vector<std::thread> producers;
+        for(int t = 0; t < threads; ++t)
+            producers.emplace_back([&logger, t]{
+                for(int i = 0; i < per_thread; ++i)
+                    logger.info(std::to_string(t) + " " + std::to_string(i));
+            });
+        for(auto &p : producers)
+            p.join();
+    }
+    auto lines = FSUtils::readLineByLine(LOG_FILE);
+    require(lines.size() == threads * per_thread);
+    std::vector<int> next(threads, 0);
+    for(auto &l : lines){
+        std::string body = afterTime(l).substr(std::string("INFO: ").size());
+        int t = std::stoi(body);
+        require(std::stoi(body.substr(body.find(' ') + 1)) == next[t]);
+        ++next[t];
+    }
+    require(next == std::vector<int>(threads, per_thread));
+    FSUtils::deleteFile(LOG_FILE);
+}
+
+test_case("TSLogger orders messages across threads"){
+    FSUtils::deleteFile(LOG_FILE);
+    {
+        TSLogger logger(LOG_FILE);
+        for(int i = 0; i < 50; ++i){
+            // Logged by one thread strictly before the other, so written in that order
+            std::thread first([&logger, i]{ logger.info("first " + std::to_string(i)); });
+            first.join();
+            std::thread second([&logger, i]{ logger.info("second " + std::to_string(i)); });
+            second.join();
+        }
+    }
+    auto lines = FSUtils::readLineByLine(LOG_FILE);
+    require(lines.size() == 100);
+    for(size_t i = 0; i < 50; ++i){
+        require(afterTime(lines[2 * i]) == "INFO: first " + std::to_string(i));
+        require(afterTime(lines[2 * i + 1]) == "INFO: second " + std::to_string(i));
+    }
+    FSUtils::deleteFile(LOG_FILE);
+}
+
+test_case("TSLogger orders overflowed messages across threads"){
+    FSUtils::deleteFile(LOG_FILE);
+    const int burst = 5000;
+    {
+        TSLogger logger(LOG_FILE);
+        // More than a thread's own queue holds, so some go through the shared queue and later sweeps
+        std::thread first([&logger]{
+            for(int i = 0; i < burst; ++i)
+                logger.info("first " + std::to_string(i));
+        });
+        first.join();
+        std::thread second([&logger]{ logger.info("second"); });
+        second.join();
+    }
+    auto lines = FSUtils::readLineByLine(LOG_FILE);
+    require(lines.size() == burst + 1);
+    for(int i = 0; i < burst; ++i)
+        require(afterTime(lines[i]) == "INFO: first " + std::to_string(i));
+    require(afterTime(lines[burst]) == "INFO: second");
+    FSUtils::deleteFile(LOG_FILE);
+}
+
+test_case("TSLogger wakes on a new message"){
+    FSUtils::deleteFile(LOG_FILE);
+    auto start = std::chrono::steady_clock::now();
+    {
+        // Would take 10 seconds per message if only the timeout woke the logger thread
+        TSLogger logger(LOG_FILE, std::chrono::milliseconds(10000));
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        logger.info("woken");
+        bool written = false;
+        for(int i = 0; i < 2000 && !written; ++i){
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            written = FSUtils::fileInfo(LOG_FILE).size_ > 0;
+        }
+        require(written);
+    }
+    require(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+    FSUtils::deleteFile(LOG_FILE);
+}
+
+test_case("TSLogger loggers come and go on one thread"){
+    FSUtils::deleteFile(LOG_FILE);
+    for(int i = 0; i < 200; ++i){
+        TSLogger logger(LOG_FILE);
+        logger.info(std::to_string(i));
+    }
+    auto lines = FSUtils::readLineByLine(LOG_FILE);
+    require(lines.size() == 200);
+    for(size_t i = 0; i < lines.size(); ++i)
+        require(afterTime(lines[i]) == "INFO: " + std::to_string(i));
+    FSUtils::deleteFile(LOG_FILE);
+}
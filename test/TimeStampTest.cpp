@@ -0,0 +1,73 @@
+//
+// TimeStampTest.cpp
+//
+
+#include <thread>
+#include <vector>
+#include "catch.hpp"
+#include "../src/TimeStamp.hpp"
+
+// All caps is killing me
+#define require REQUIRE
+#define test_case TEST_CASE
+
+namespace{
+    // 2017-11-23 04:05:06 UTC
+    const std::chrono::system_clock::time_point KNOWN_TIME =
+        std::chrono::system_clock::time_point(std::chrono::seconds(1511409906));
+}
+
+test_case("TimeStamp UTC"){
+    TimeStamp ms(TimeStamp::Clock::UTC);
+    TimeStamp us(TimeStamp::Clock::UTC, TimeStamp::Precision::MICRO);
+
+    require(ms.format(KNOWN_TIME) == "2017-11-23 04:05:06.000");
+    require(us.format(KNOWN_TIME) == "2017-11-23 04:05:06.000000");
+
+    // Millisecond field is always zero padded
+    auto tp = KNOWN_TIME + std::chrono::milliseconds(5);
+    require(ms.format(tp) == "2017-11-23 04:05:06.005");
+    require(us.format(tp + std::chrono::microseconds(7)) == "2017-11-23 04:05:06.005007");
+
+    // Prefix is re-rendered when the second rolls over
+    require(ms.format(KNOWN_TIME + std::chrono::milliseconds(1999)) == "2017-11-23 04:05:07.999");
+    require(ms.format(KNOWN_TIME) == "2017-11-23 04:05:06.000");
+}
+
+test_case("TimeStamp LOCAL"){
+    TimeStamp stamp;
+    auto str = stamp.now();
+    require(str.size() == 23);
+    require(str[4] == '-');
+    require(str[10] == ' ');
+    require(str[19] == '.');
+}
+
+test_case("TimeStamp MONOTONIC"){
+    TimeStamp stamp(TimeStamp::Clock::MONOTONIC);
+    require(stamp.format(std::chrono::system_clock::time_point()) == "0.000");
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    auto str = stamp.now();
+    require(str.substr(0, 2) == "0.");
+    require(str != "0.000");
+}
+
+test_case("TimeStamp shared between threads"){
+    TimeStamp stamp(TimeStamp::Clock::UTC);
+    std::vector<std::thread> threads;
+    std::vector<int> ok(4, 1);
+    for(size_t i = 0; i < ok.size(); ++i){
+        threads.emplace_back([&stamp, &ok, i]{
+            for(int j = 0; j < 1000; ++j){
+                auto tp = KNOWN_TIME + std::chrono::seconds(static_cast<int>(i));
+                if(stamp.format(tp) != "2017-11-23 04:05:0" + std::to_string(6 + i) + ".000")
+                    ok[i] = 0;
+            }
+        });
+    }
+    for(auto &&t : threads)
+        t.join();
+    for(auto b : ok)
+        require(b);
+}